@@ -1,12 +1,58 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
-#include <set>
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <thread>
+#include <chrono>
 #include "AI.h"
 #include "Player.h"
 #include "util.h"
 
-AI::AI(Connection* conn) : BaseAI(conn) {}
+//The late move reduction for each depth left and move number, both capped at 63
+static int Reductions[64][64];
+
+/*************************************************************************/
+//Fills the late move reductions, they grow with the log of both the depth left and the move number
+static void initReductions()
+{
+	for(int d = 0; d < 64; d++)
+	{
+		for(int m = 0; m < 64; m++)
+		{
+			Reductions[d][m] = d == 0 || m == 0 ? 0 : int(0.5 + log(double(d)) * log(double(m)) / 2);
+		}
+	}
+}
+
+mySearch::mySearch() : nodes(0), id(0), splitPoint(NULL)
+{
+	memset(history, 0, sizeof(history));
+	memset(killers, 0, sizeof(killers));
+	memset(counterMoves, 0, sizeof(counterMoves));
+}
+
+AI::AI(Connection* conn) : BaseAI(conn), searchDepth(MAX_PLY / 2), stopSearch(false), openSplits(0), idleThreads(0)
+{
+	setSearchThreads(SEARCH_THREADS, SEARCH_BACKEND);
+}
+
+void AI::setSearchDepth(int depth)
+{
+	searchDepth = depth < 1 ? 1 : depth;
+}
+
+void AI::setSearchThreads(int threads, SearchBackend backend)
+{
+	threadCount = threads < 1 ? 1 : threads;
+	this->backend = backend;
+	searches.resize(threadCount);
+	for(int i = 0; i < threadCount; i++)
+	{
+		searches[i].id = i;
+	}
+}
 
 const char* AI::username()
 {
@@ -22,6 +68,10 @@ const char* AI::password()
 void AI::init()
 {
 	srand(time(NULL));
+	initBitboards();
+	initZobrist();
+	initReductions();
+	tt.resize(TT_MB);
 }
 
 //This function is called each time it is your turn.
@@ -84,67 +134,89 @@ bool AI::run()
 	if(moves.size() > 0)
 	{
 		cout<<"Last Move Was: "<<endl<<moves[0]<<endl;
-		// copy the last eight moves to the state
-		size_t ssize = 8;
-		if(moves.size() < ssize)
-		{
-			ssize = moves.size();
-		}
-	
-		for(size_t p=0; p<ssize;p++)
-		{
-			myMove move;
-			move.fromFile = moves[p].fromFile();
-			move.toFile = moves[p].toFile();
-			move.fromRank = moves[p].fromRank();
-			move.toRank = moves[p].toRank();
-			move.promoteType = moves[p].promoteType();
-			oldState.lastMoves.push_back(move);
-		}
 	}
   
 	// find the turns left for draw for the state
 	int turnsToDraw = TurnsToStalemate();
    
-	oldState.turnsWithNoPorC = turnsToDraw;
+	oldState.turnsWithNoPorC = std::max(100 - turnsToDraw, 0);
 	
-	if(turnsToDraw > 8)
-	{
-		turnsToDraw = 8;
-	}
-  
-	oldState.turnsLeft = turnsToDraw;
+	memset(oldState.pieces, 0, sizeof(oldState.pieces));
+	memset(oldState.occupied, 0, sizeof(oldState.occupied));
+	oldState.epSquare = NO_SQUARE;
 	
-	oldState.isQS = 0;
-	memset(oldState.board, ' ', sizeof(oldState.board));
+	// the pieces that have not moved yet
+	Bitboard notMoved = 0;
  
 	for (size_t p=0; p<pieces.size(); p++)
 	{
-		if (pieces[p].owner() == 0)		// White pieces use uppercase letters
+		int square = makeSquare(pieces[p].file()-1, 8-pieces[p].rank());
+		int owner = pieces[p].owner();
+		oldState.pieces[owner][charPieceType(pieces[p].type())] |= squareBB(square);
+		oldState.occupied[owner] |= squareBB(square);
+		if(!pieces[p].hasMoved())
+		{
+			notMoved |= squareBB(square);
+		}
+	}
+	
+	// castling needs the king and the rook on their first squares
+	Bitboard kingsAndRooks = notMoved & (oldState.pieces[0][KING] | oldState.pieces[0][ROOK] | oldState.pieces[1][KING] | oldState.pieces[1][ROOK]);
+	oldState.castling = 0;
+	for(int player = 0; player < 2; player++)
+	{
+		int rank = player ? 0 : 7;
+		if(kingsAndRooks & squareBB(makeSquare(4, rank)))
 		{
-			oldState.board[8-pieces[p].rank()][pieces[p].file()-1] = (char) pieces[p].type();
+			if(kingsAndRooks & squareBB(makeSquare(7, rank)))
+			{
+				oldState.castling |= player ? BLACK_OO : WHITE_OO;
+			}
+			if(kingsAndRooks & squareBB(makeSquare(0, rank)))
+			{
+				oldState.castling |= player ? BLACK_OOO : WHITE_OOO;
+			}
 		}
-		else // Black pieces use lowercase letters
+	}
+	
+	// a pawn that has just moved forward two squares can be captured en passant
+	if(moves.size() > 0 && abs(moves[0].toRank() - moves[0].fromRank()) == 2 && moves[0].fromFile() == moves[0].toFile()
+		&& (oldState.pieces[!playerID()][PAWN] & squareBB(makeSquare(moves[0].toFile()-1, 8-moves[0].toRank()))))
+	{
+		int epSquare = makeSquare(moves[0].toFile()-1, 8-(moves[0].fromRank() + moves[0].toRank())/2);
+		if(PawnAttacks[!playerID()][epSquare] & oldState.pieces[playerID()][PAWN])
 		{
-			oldState.board[8-pieces[p].rank()][pieces[p].file()-1] = std::tolower(pieces[p].type());
+			oldState.epSquare = epSquare;
 		}
-		oldState.hasMoved[8-pieces[p].rank()][pieces[p].file()-1] = pieces[p].hasMoved();
 	}
+	
+	oldState.sideToMove = playerID();
+	oldState.key = computeKey(oldState);
+	
+	// the positions of the game before this one, for the repetitions
+	replayGame(oldState);
   
 	//determine next move using Time-Limited Iterative-Deepening Depth-Limited MiniMax with alpha-beta pruning 
 	myMove mmove = nextMove(oldState);
   
 	//If there is no legal move
-	if(mmove.toRank == 999) {
+	if(mmove == myMove()) {
 		return true;
 	}
 	
+	//the server counts the files and ranks from 1, with rank 1 on white's side
+	int fromFile = mmove.fromFile()+1;
+	int fromRank = 8-mmove.fromRank();
+	int toFile = mmove.toFile()+1;
+	int toRank = 8-mmove.toRank();
+	int promoteType = mmove.type() == PROMOTION ? pieceTypeChar(mmove.promoteType()) : '\0';
+	
 	//find the pieces to be moved
 	int  movedPiece= -1;
 	
 	for (size_t i = 0; i < pieces.size(); i++)
 	{
-		if (pieces[i].file() == mmove.fromFile+1 && pieces[i].rank() == 8-mmove.fromRank)
+		if (pieces[i].file() == fromFile && pieces[i].rank() == fromRank)
 		{
 			movedPiece = i;
 			break;
@@ -153,15 +225,15 @@ bool AI::run()
 	
 
 	//move the piece based on random search
-	pieces[movedPiece].move(mmove.toFile+1, 8-mmove.toRank, mmove.promoteType);
+	pieces[movedPiece].move(toFile, toRank, promoteType);
   
 	//Print the move
-	printf("Moved piece: %c\n", oldState.board[mmove.fromRank][mmove.fromFile]);
-	printf("From %d rank, from %d file\n", 8-mmove.fromRank, mmove.fromFile+1);
-	printf("To %d rank, to %d file\n", 8-mmove.toRank, mmove.toFile+1);
-	if(mmove.promoteType != '\0')
+	printf("Moved piece: %c\n", pieceAt(oldState, mmove.from()));
+	printf("From %d rank, from %d file\n", fromRank, fromFile);
+	printf("To %d rank, to %d file\n", toRank, toFile);
+	if(promoteType != '\0')
 	{
-		printf("Promotion Type: %c\n", mmove.promoteType);
+		printf("Promotion Type: %c\n", promoteType);
 	}
 
 	return true;
@@ -171,1502 +243,2069 @@ bool AI::run()
 void AI::end(){}
 
 /*************************************************************************/
-
-myStates AI::nextStates(const myState &s, int player)
+void AI::replayGame(const myState &root)
 {
-	myStates states;
-	myState nState;
-	
-	//first check if the king is in check
-	bool kingInCheck = false;
-	kingInCheck = inCheck(s, !player);
+	static const int backRank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+	gameMoves.clear();
+	gameKeys.clear();
+	
+	//the search of the main thread is set up again by nextMove, so it plays the game here
+	mySearch &ss = searches[0];
+	myState &s = ss.state;
+	memset(s.pieces, 0, sizeof(s.pieces));
+	for(int file = 0; file < 8; file++)
+	{
+		s.pieces[BLACK][backRank[file]] |= squareBB(makeSquare(file, 0));
+		s.pieces[BLACK][PAWN] |= squareBB(makeSquare(file, 1));
+		s.pieces[WHITE][PAWN] |= squareBB(makeSquare(file, 6));
+		s.pieces[WHITE][backRank[file]] |= squareBB(makeSquare(file, 7));
+	}
+	s.occupied[BLACK] = 0xFFFFULL;
+	s.occupied[WHITE] = 0xFFFFULL << 48;
+	s.epSquare = NO_SQUARE;
+	s.castling = WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO;
+	s.turnsWithNoPorC = 0;
+	s.sideToMove = WHITE;
+	s.key = computeKey(s);
+	
+	//the moves of the server are the newest first, with files and ranks from 1
+	ss.undoStack.clear();
+	for(size_t i = moves.size(); i > 0; i--)
+	{
+		int from = makeSquare(moves[i-1].fromFile()-1, 8-moves[i-1].fromRank());
+		int to = makeSquare(moves[i-1].toFile()-1, 8-moves[i-1].toRank());
+		int player = s.sideToMove;
+		if(!(s.occupied[player] & squareBB(from)))
+		{
+			break;
+		}
+		//the server does not say what kind of move it is, the pieces do
+		myMove m = myMove::make(from, to);
+		if(s.pieces[player][PAWN] & squareBB(from))
+		{
+			int promote = charPieceType(moves[i-1].promoteType());
+			if(to == s.epSquare)
+			{
+				m = myMove::make(from, to, EN_PASSANT);
+			}
+			else if(rankOf(to) == 0 || rankOf(to) == 7)
+			{
+				m = myMove::make(from, to, PROMOTION, promote >= KNIGHT && promote <= QUEEN ? promote : QUEEN);
+			}
+		}
+		else if((s.pieces[player][KING] & squareBB(from)) && abs(to - from) == 2)
+		{
+			m = myMove::make(from, to, CASTLING);
+		}
+		
+		//when the keys are full the oldest is dropped, only the latest 100 plies can be repeated
+		if(gameKeys.size() == MAX_GAME_KEYS)
+		{
+			std::copy(gameKeys.begin() + 1, gameKeys.end(), gameKeys.begin());
+			gameKeys.pop_back();
+		}
+		gameKeys.push_back(s.key);
+		ss.undoStack.clear();
+		makeMove(ss, m);
+		//a capture or a pawn move can not be taken back, the positions before it never come again
+		if(ss.undoStack.back().captured != NO_PIECE || ss.undoStack.back().moved == PAWN)
+		{
+			gameKeys.clear();
+		}
+	}
 	
-	myMoves moves = legalMoves(s, player, kingInCheck);
+	if(!moves.empty() && s.key == root.key)
+	{
+		gameMoves.push_back(ss.undoStack.back());
+	}
+	//the game did not start from the initial position, or a move is not the one understood here
+	else if(!moves.empty())
+	{
+		gameKeys.clear();
+		myUndo u = myUndo();
+		int to = makeSquare(moves[0].toFile()-1, 8-moves[0].toRank());
+		u.move = myMove::make(makeSquare(moves[0].fromFile()-1, 8-moves[0].fromRank()), to);
+		u.moved = pieceTypeAt(root, to, !playerID());
+		u.captured = NO_PIECE;
+		gameMoves.push_back(u);
+	}
+}
+
+/*************************************************************************/
+//If a move is not a capture or a promotion, in the state it is made in
+static bool isQuiet(const myState &s, const myMove &m)
+{
+	return m.type() != PROMOTION && m.type() != EN_PASSANT && !(s.occupied[!s.sideToMove] & squareBB(m.to()));
+}
+
+/*************************************************************************/
+
+myMoveScores &AI::orderedMoves(mySearch &ss, int player, uint16_t hashMove)
+{
+	myState &s = ss.state;
+	size_t ply = ss.undoStack.size();
+	myMoves &moves = ss.genStack[ply];
+	myMoveScores &scores = ss.moveStack[ply];
+	myMoveScore ms;
+	scores.clear();
+	
+	myCheckInfo ci;
+	checkInfo(s, player, ci);
+	moves.clear();
+	legalMoves(s, player, moves, ci);
+	
+	//the reply that refuted the last move before
+	const myMove *counter = NULL;
+	if(ply > 0 && ss.undoStack[ply - 1].moved != NO_PIECE)
+	{
+		const myUndo &last = ss.undoStack[ply - 1];
+		counter = &ss.counterMoves[!s.sideToMove][last.moved][last.move.to()];
+	}
 	
-	//create new states
-	while(!moves.empty())
+	for(size_t i = 0; i < moves.size(); i++)
 	{
-		nState = newState(s, moves.back(), player);
-		/* If the move won't cause a checkmate, add the new state for evaluation */
-		if(!inCheck(nState, !player))
+		ms.move = moves[i];
+		bool quiet = isQuiet(s, ms.move);
+		//The best move of the last search of this state goes first
+		if(hashMove != 0 && ms.move.data == hashMove)
+		{
+			ms.histScore = INT_MAX;
+		}
+		//The quiet moves that caused a cutoff at this ply, or after the last move
+		else if(quiet && ms.move.data == ss.killers[ply][0].data)
+		{
+			ms.histScore = KILLER_SCORE + 2;
+		}
+		else if(quiet && ms.move.data == ss.killers[ply][1].data)
+		{
+			ms.histScore = KILLER_SCORE + 1;
+		}
+		else if(quiet && counter != NULL && ms.move.data == counter->data)
 		{
-			states.push(nState);
+			ms.histScore = KILLER_SCORE;
 		}
-		moves.pop_back();
+		else
+		{
+			const myMove &m = moves[i];
+			ms.histScore = ss.history[player][m.from()][m.to()];
+			//Captures and promotions go before the killers
+			if(!quiet)
+			{
+				ms.histScore += CAPTURE_SCORE;
+			}
+		}
+		scores.push_back(ms);
 	}
 	
-	return states;
+	std::sort(scores.begin(), scores.end(), score_comp());
+	return scores;
 }
 
-/**********************************************************************/
-myState AI::newState(myState s, const myMove &m, int player)
+/*************************************************************************/
+void AI::initPicker(mySearch &ss, myMovePicker &mp, int player, uint16_t hashMove, bool quiescence)
+{
+	mp.player = player;
+	mp.ply = ss.undoStack.size();
+	mp.stage = PICK_HASH;
+	mp.hashMove = hashMove;
+	mp.current = 0;
+	mp.badCaptures = 0;
+	mp.quiescence = quiescence;
+	checkInfo(ss.state, player, mp.ci);
+	mp.refutations[0] = ss.killers[mp.ply][0];
+	mp.refutations[1] = ss.killers[mp.ply][1];
+	mp.refutations[2] = myMove();
+	if(mp.ply > 0 && ss.undoStack[mp.ply - 1].moved != NO_PIECE)
+	{
+		const myUndo &last = ss.undoStack[mp.ply - 1];
+		mp.refutations[2] = ss.counterMoves[!player][last.moved][last.move.to()];
+	}
+}
+
+/*************************************************************************/
+bool AI::pickMove(mySearch &ss, myMovePicker &mp, myMove &m)
 {
-	s.move = m;
-	std::map<myMove, int>::iterator it;
-	it = history.find(s.move);
-	s.isQS = 1;
+	const myState &s = ss.state;
+	myMoves &moves = ss.genStack[mp.ply];
+	myMoveScores &scores = ss.moveStack[mp.ply];
+	myMoveScore ms;
 	
-	//If the movement can be found in the history table
-	if(it != history.end())
+	while(true)
+	{
+		switch(mp.stage)
+		{
+			//the hash move is not generated, so it is checked first
+			case PICK_HASH:
+				mp.stage++;
+				if(mp.hashMove != 0)
+				{
+					m = myMove(mp.hashMove);
+					if(!(mp.quiescence && isQuiet(s, m)) && legalMove(s, m, mp.ci, moves))
+					{
+						return true;
+					}
+				}
+				break;
+			
+			//captures of the most valuable victims first, by the least valuable attackers
+			case PICK_GEN_CAPTURES:
+				moves.clear();
+				legalMoves(s, mp.player, moves, mp.ci, GEN_CAPTURES);
+				scores.clear();
+				for(size_t i = 0; i < moves.size(); i++)
+				{
+					const myMove &c = moves[i];
+					int victim = pieceTypeAt(s, c.to(), !mp.player);
+					ms.move = c;
+					ms.histScore = KING - pieceTypeAt(s, c.from(), mp.player);
+					if(victim != NO_PIECE)
+					{
+						ms.histScore += 8 * victim;
+					}
+					else if(c.type() == EN_PASSANT)
+					{
+						ms.histScore += 8 * PAWN;
+					}
+					if(c.type() == PROMOTION)
+					{
+						ms.histScore += 8 * c.promoteType();
+					}
+					scores.push_back(ms);
+				}
+				mp.current = 0;
+				mp.stage++;
+				break;
+			
+			case PICK_CAPTURES:
+			case PICK_QUIETS:
+				while(mp.current < scores.size())
+				{
+					//only the moves that are picked get sorted
+					size_t best = mp.current;
+					for(size_t i = mp.current + 1; i < scores.size(); i++)
+					{
+						if(scores[i].histScore > scores[best].histScore)
+						{
+							best = i;
+						}
+					}
+					std::swap(scores[mp.current], scores[best]);
+					m = scores[mp.current++].move;
+					
+					uint16_t packed = m.data;
+					if(packed == mp.hashMove)
+					{
+						continue;
+					}
+					if(mp.stage == PICK_QUIETS && (packed == mp.refutations[0].data
+						|| packed == mp.refutations[1].data || packed == mp.refutations[2].data))
+					{
+						continue;
+					}
+					//the captures that lose material wait at the front of the buffer until the killers are done
+					if(mp.stage == PICK_CAPTURES && see(s, m) < 0)
+					{
+						if(!mp.quiescence)
+						{
+							scores[mp.badCaptures++] = scores[mp.current - 1];
+						}
+						continue;
+					}
+					return true;
+				}
+				mp.current = 0;
+				mp.stage = mp.quiescence && mp.stage == PICK_CAPTURES ? PICK_DONE : mp.stage + 1;
+				break;
+			
+			//the quiet moves that caused a cutoff at this ply or after the last move
+			case PICK_REFUTATIONS:
+				while(mp.current < 3)
+				{
+					m = mp.refutations[mp.current++];
+					uint16_t packed = m.data;
+					if(packed == 0 || packed == mp.hashMove
+						|| (mp.current > 1 && packed == mp.refutations[0].data)
+						|| (mp.current > 2 && packed == mp.refutations[1].data))
+					{
+						continue;
+					}
+					if(isQuiet(s, m) && legalMove(s, m, mp.ci, moves))
+					{
+						return true;
+					}
+				}
+				mp.current = 0;
+				mp.stage++;
+				break;
+			
+			//the captures that lose material, in MVV-LVA order
+			case PICK_BAD_CAPTURES:
+				if(mp.current < mp.badCaptures)
+				{
+					m = scores[mp.current++].move;
+					return true;
+				}
+				mp.stage++;
+				break;
+			
+			case PICK_GEN_QUIETS:
+				moves.clear();
+				legalMoves(s, mp.player, moves, mp.ci, GEN_QUIETS);
+				scores.resize(mp.badCaptures);
+				for(size_t i = 0; i < moves.size(); i++)
+				{
+					const myMove &q = moves[i];
+					ms.move = q;
+					ms.histScore = ss.history[mp.player][q.from()][q.to()];
+					scores.push_back(ms);
+				}
+				mp.current = mp.badCaptures;
+				mp.stage++;
+				break;
+			
+			default:
+				return false;
+		}
+	}
+}
+
+/*************************************************************************/
+myMoveScores &AI::pickRemaining(mySearch &ss, myMovePicker &mp, const myMove &first)
+{
+	myMoveScores &rest = ss.splitStack[mp.ply];
+	myMoveScore ms;
+	ms.histScore = 0;
+	ms.move = first;
+	rest.clear();
+	rest.push_back(ms);
+	while(pickMove(ss, mp, ms.move))
 	{
-		s.histScore = history[s.move];
+		rest.push_back(ms);
 	}
-	//If the movement can not be found in the history table
-	else
+	return rest;
+}
+
+/*************************************************************************/
+bool AI::legalMove(const myState &s, const myMove &m, const myCheckInfo &ci, myMoves &buffer)
+{
+	int from = m.from();
+	int player = s.sideToMove;
+	int type = pieceTypeAt(s, from, player);
+	buffer.clear();
+	switch(type)
+	{
+		case KING: KingMove(s, from, player, buffer, ci); break;
+		case QUEEN: QueenMove(s, from, player, buffer, ci); break;
+		case BISHOP: BishopMove(s, from, player, buffer, ci); break;
+		case ROOK: RookMove(s, from, player, buffer, ci); break;
+		case KNIGHT: KnightMove(s, from, player, buffer, ci); break;
+		case PAWN: PawnMove(s, from, player, buffer, ci); break;
+		default: return false;
+	}
+	for(size_t i = 0; i < buffer.size(); i++)
+	{
+		if(buffer[i] == m)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**********************************************************************/
+//The castling rights lost when a piece moves from or to a square
+static int castlingLost(int square)
+{
+	switch(square)
 	{
-		s.histScore = 0;
+		case 0: return BLACK_OOO;              //a8
+		case 4: return BLACK_OO | BLACK_OOO;   //e8
+		case 7: return BLACK_OO;               //h8
+		case 56: return WHITE_OOO;             //a1
+		case 60: return WHITE_OO | WHITE_OOO;  //e1
+		case 63: return WHITE_OO;              //h1
 	}
+	return 0;
+}
+
+/**********************************************************************/
+void AI::makeMove(mySearch &ss, const myMove &m)
+{
+	myState &s = ss.state;
+	int player = s.sideToMove;
+	int from = m.from();
+	int to = m.to();
+	
+	ss.undoStack.push_back(myUndo());
+	myUndo &u = ss.undoStack.back();
+	u.move = m;
+	u.moved = pieceTypeAt(s, from, player);
+	u.captured = pieceTypeAt(s, to, !player);
+	u.epSquare = s.epSquare;
+	u.castling = s.castling;
+	u.turnsWithNoPorC = s.turnsWithNoPorC;
+	u.key = s.key;
 	
 	//determine turns left for draw
 	//capture
-	if(s.board[m.toRank][m.toFile] != ' ') 
+	if(u.captured != NO_PIECE) 
 	{
-		s.turnsLeft = 8;
 		s.turnsWithNoPorC = 0;
-		s.isQS = 0;
 	}
 	//Pawn action
-	else if(s.board[m.fromRank][m.fromFile] == 'p' || s.board[m.fromRank][m.fromFile] == 'P')
+	else if(u.moved == PAWN)
 	{
-		s.turnsLeft = 8;
 		s.turnsWithNoPorC = 0;
-		s.isQS = 0;
-	}
-	//Promotion
-	else if(m.promoteType != '\0')
-	{
-		s.turnsLeft = 8;
-		s.isQS = 0;
 	}
 	else
 	{
-		s.turnsLeft--;
 		s.turnsWithNoPorC++;
 	}
 	
-	//track the last eight moves
-	if(s.lastMoves.size() < 8)
+	//Move the piece
+	
+	//Capture
+	if(u.captured != NO_PIECE)
 	{
-		s.lastMoves.push_back(m);
+		s.pieces[!player][u.captured] ^= squareBB(to);
+		s.occupied[!player] ^= squareBB(to);
+		s.key ^= ZobristPieces[!player][u.captured][to];
 	}
-	else
+	//En passant, the captured pawn is beside the moving pawn
+	else if(m.type() == EN_PASSANT)
 	{
-		s.lastMoves.erase(s.lastMoves.begin());
-		s.lastMoves.push_back(m);
+		int capSquare = makeSquare(m.toFile(), m.fromRank());
+		u.captured = PAWN;
+		s.pieces[!player][PAWN] ^= squareBB(capSquare);
+		s.occupied[!player] ^= squareBB(capSquare);
+		s.key ^= ZobristPieces[!player][PAWN][capSquare];
 	}
 	
-	
-	//Move the piece
-	
+	s.pieces[player][u.moved] ^= squareBB(from);
+	s.key ^= ZobristPieces[player][u.moved][from];
 	//For promotion
-	if(m.promoteType != '\0')
+	if(m.type() == PROMOTION)
 	{
-		s.board[m.toRank][m.toFile] = m.promoteType;
-		if(s.board[m.fromRank][m.fromFile] == 'p')
-		{
-			s.board[m.toRank][m.toFile] += 32;
-		}
+		s.pieces[player][m.promoteType()] ^= squareBB(to);
+		s.key ^= ZobristPieces[player][m.promoteType()][to];
 	}
 	else
 	{
-		s.board[m.toRank][m.toFile] = s.board[m.fromRank][m.fromFile];
+		s.pieces[player][u.moved] ^= squareBB(to);
+		s.key ^= ZobristPieces[player][u.moved][to];
+	}
+	s.occupied[player] ^= squareBB(from) | squareBB(to);
+	s.castling &= ~(castlingLost(from) | castlingLost(to));
+	s.key ^= ZobristCastling[u.castling] ^ ZobristCastling[s.castling];
+	
+	//a pawn moving two squares can be captured en passant on the next move, if a pawn is there to do it
+	if(s.epSquare != NO_SQUARE)
+	{
+		s.key ^= ZobristEnPassant[fileOf(s.epSquare)];
+		s.epSquare = NO_SQUARE;
+	}
+	if(u.moved == PAWN && abs(to - from) == 16)
+	{
+		int epSquare = (from + to) / 2;
+		if(PawnAttacks[player][epSquare] & s.pieces[!player][PAWN])
+		{
+			s.epSquare = epSquare;
+			s.key ^= ZobristEnPassant[fileOf(from)];
+		}
 	}
-		s.board[m.fromRank][m.fromFile] = ' ';
 	
+	s.sideToMove = !player;
+	s.key ^= ZobristSide;
 	
 	//castling
-	if((s.board[m.toRank][m.toFile] == 'K' || s.board[m.toRank][m.toFile] == 'k') && abs(m.toFile - m.fromFile) == 2)
+	if(m.type() == CASTLING)
 	{
-		if(m.toRank == 7) //white
+		int rookFrom, rookTo;
+		if(m.toFile() == 2) //left side of board
 		{
-			if(m.toFile == 2) //left side of board
-			{
-				s.board[7][0] = ' ';
-				s.board[7][2] = 'R';
-			}
-			else //right side of board
-			{
-				s.board[7][7] = ' ';
-				s.board[7][5] = 'R';
-			}
+			rookFrom = makeSquare(0, m.toRank());
+			rookTo = makeSquare(3, m.toRank());
 		}
-		else //black
+		else //right side of board
 		{
-			if(m.toFile == 2) //left side of board
-			{
-				s.board[0][0] = ' ';
-				s.board[0][2] = 'r';
-			}
-			else //right side of board
-			{
-				s.board[0][7] = ' ';
-				s.board[0][5] = 'r';
-			}
+			rookFrom = makeSquare(7, m.toRank());
+			rookTo = makeSquare(5, m.toRank());
 		}
+		s.pieces[player][ROOK] ^= squareBB(rookFrom) | squareBB(rookTo);
+		s.occupied[player] ^= squareBB(rookFrom) | squareBB(rookTo);
+		s.key ^= ZobristPieces[player][ROOK][rookFrom] ^ ZobristPieces[player][ROOK][rookTo];
 	}
-	
-	return s;
 }
 
-/***************************************************************************/
-myMoves AI::legalMoves(const myState & s, int player, bool inCheck)
+/**********************************************************************/
+void AI::unmakeMove(mySearch &ss)
 {
-	myMoves nextMoves;
+	myState &s = ss.state;
+	const myUndo &u = ss.undoStack.back();
+	const myMove &m = u.move;
+	int player = !s.sideToMove;
+	int from = m.from();
+	int to = m.to();
+	
+	//Move the piece back
+	s.pieces[player][u.moved] ^= squareBB(from);
+	if(m.type() == PROMOTION)
+	{
+		s.pieces[player][m.promoteType()] ^= squareBB(to);
+	}
+	else
+	{
+		s.pieces[player][u.moved] ^= squareBB(to);
+	}
+	s.occupied[player] ^= squareBB(from) | squareBB(to);
 	
-	//Find the possible nextMoves for all the pieces
-	for(int file = 0; file < 8; file++)
+	//castling
+	if(m.type() == CASTLING)
 	{
-		for(int rank = 0; rank < 8; rank++)
-		{
-			
-			//King
-			if(( !player && s.board[rank][file] == 'K') || ( player&& s.board[rank][file] == 'k'))
-			{
-				KingMove(s, file, rank, player, nextMoves, inCheck);
-			}
-			
-			//Bishop
-			if((!player && s.board[rank][file] == 'B') || ( player && s.board[rank][file] == 'b'))
-			{
-				BishopMove(s, file, rank, player, nextMoves);
-			}
-			
-			//Queen
-			if((!player && s.board[rank][file] == 'Q') || ( player && s.board[rank][file] == 'q'))
-			{
-				QueenMove(s, file, rank, player, nextMoves);
-			}
-			
-			//Rook
-			if((!player && s.board[rank][file] == 'R') || ( player && s.board[rank][file] == 'r'))
-			{
-				RookMove(s, file, rank, player, nextMoves);
-			}
-			
-			//Knight
-			if((!player && s.board[rank][file] == 'N') || ( player && s.board[rank][file] == 'n'))
-			{
-				KnightMove(s, file, rank, player, nextMoves);
-				
-			}
-			
-			//Pawn
-			if(s.board[rank][file] == 'P' || s.board[rank][file] == 'p')
-			{
-				PawnMove(s, file, rank, player, nextMoves);
-			}
-		}
+		int rookFrom = makeSquare(m.toFile() == 2 ? 0 : 7, m.toRank());
+		int rookTo = makeSquare(m.toFile() == 2 ? 3 : 5, m.toRank());
+		s.pieces[player][ROOK] ^= squareBB(rookFrom) | squareBB(rookTo);
+		s.occupied[player] ^= squareBB(rookFrom) | squareBB(rookTo);
 	}
 	
-	return nextMoves;
+	//Put the captured piece back
+	if(u.captured != NO_PIECE)
+	{
+		int capSquare = m.type() == EN_PASSANT ? makeSquare(m.toFile(), m.fromRank()) : to;
+		s.pieces[!player][u.captured] ^= squareBB(capSquare);
+		s.occupied[!player] ^= squareBB(capSquare);
+	}
 	
+	s.epSquare = u.epSquare;
+	s.castling = u.castling;
+	s.turnsWithNoPorC = u.turnsWithNoPorC;
+	s.sideToMove = player;
+	s.key = u.key;
+	ss.undoStack.pop_back();
+}
+
+/**********************************************************************/
+void AI::makeNullMove(mySearch &ss)
+{
+	myState &s = ss.state;
+	ss.undoStack.push_back(myUndo());
+	myUndo &u = ss.undoStack.back();
+	u.move = myMove();
+	u.moved = NO_PIECE;
+	u.captured = NO_PIECE;
+	u.epSquare = s.epSquare;
+	u.castling = s.castling;
+	u.turnsWithNoPorC = s.turnsWithNoPorC;
+	u.key = s.key;
+	
+	//only the turn changes, the en passant capture is lost
+	if(s.epSquare != NO_SQUARE)
+	{
+		s.key ^= ZobristEnPassant[fileOf(s.epSquare)];
+		s.epSquare = NO_SQUARE;
+	}
+	s.sideToMove = !s.sideToMove;
+	s.key ^= ZobristSide;
 }
 
+/**********************************************************************/
+void AI::unmakeNullMove(mySearch &ss)
+{
+	myState &s = ss.state;
+	const myUndo &u = ss.undoStack.back();
+	s.epSquare = u.epSquare;
+	s.sideToMove = !s.sideToMove;
+	s.key = u.key;
+	ss.undoStack.pop_back();
+}
 
-/************************************************************************************************************/
-bool AI::inCheck(const myState &s, int player)
+/**********************************************************************/
+Key AI::computeKey(const myState &s)
 {
-	myMoves nextMoves;
-	bool inTheCheck = false;
-		
-	//Find the possible nextMoves for all the pieces and check if it will cause a checkmate
-	for(int file = 0; file < 8; file++)
+	Key key = ZobristCastling[s.castling];
+	
+	for(int player = 0; player < 2; player++)
 	{
-		for(int rank = 0; rank < 8; rank++)
+		for(int type = PAWN; type <= KING; type++)
 		{
-			
-			//King
-			if((!player && s.board[rank][file] == 'K') || ( player && s.board[rank][file] == 'k'))
+			for(Bitboard b = s.pieces[player][type]; b; )
 			{
-				inTheCheck = KingMove(s, file, rank, player, nextMoves, false);
+				key ^= ZobristPieces[player][type][popLsb(b)];
 			}
-			
-			//Bishop + Diagonal Queen
-			if((!player && s.board[rank][file] == 'B') || ( player && s.board[rank][file] == 'b'))
-			{
-				inTheCheck = BishopMove(s, file, rank, player, nextMoves);
-			}
-			
-			
-			if((!player && s.board[rank][file] == 'Q') || ( player && s.board[rank][file] == 'q'))
-			{
-				inTheCheck = QueenMove(s, file, rank, player, nextMoves);
-			}
-			
-			//Rook and Orthoganal Queen
-			if((!player && s.board[rank][file] == 'R') || ( player && s.board[rank][file] == 'r'))
-			{
-				inTheCheck = RookMove(s, file, rank, player, nextMoves);
-			}
-			
-			//Knight
-			if((!player && s.board[rank][file] == 'N') || ( player && s.board[rank][file] == 'n'))
+		}
+	}
+	if(s.epSquare != NO_SQUARE)
+	{
+		key ^= ZobristEnPassant[fileOf(s.epSquare)];
+	}
+	if(s.sideToMove == BLACK)
+	{
+		key ^= ZobristSide;
+	}
+	return key;
+}
+
+/***************************************************************************/
+void AI::checkInfo(const myState &s, int player, myCheckInfo &ci)
+{
+	ci.checkers = 0;
+	ci.pinned = 0;
+	ci.checkMask = ~0ULL;
+	if(!s.pieces[player][KING])
+	{
+		ci.kingSquare = NO_SQUARE;
+		return;
+	}
+	ci.kingSquare = lsb(s.pieces[player][KING]);
+	Bitboard occupied = s.occupied[0] | s.occupied[1];
+	ci.checkers = attackersTo(s, ci.kingSquare, occupied) & s.occupied[!player];
+	if(ci.checkers)
+	{
+		//a double check can only be answered by a king move
+		ci.checkMask = popCount(ci.checkers) > 1 ? 0
+			: BetweenSquares[ci.kingSquare][lsb(ci.checkers)] | ci.checkers;
+	}
+	
+	//a piece is pinned when it is the only piece between the king and a slider of the opponent
+	const Bitboard *theirs = s.pieces[!player];
+	Bitboard snipers = (bishopAttacks(ci.kingSquare, 0) & (theirs[BISHOP] | theirs[QUEEN]))
+		| (rookAttacks(ci.kingSquare, 0) & (theirs[ROOK] | theirs[QUEEN]));
+	while(snipers)
+	{
+		Bitboard between = BetweenSquares[ci.kingSquare][popLsb(snipers)] & occupied;
+		if(between && !(between & (between - 1)) && (between & s.occupied[player]))
+		{
+			ci.pinned |= between;
+		}
+	}
+}
+
+/***************************************************************************/
+void AI::legalMoves(const myState & s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	if(ci.checkers)
+	{
+		evasions(s, player, nextMoves, ci, type);
+		return;
+	}
+	
+	//King
+	for(Bitboard b = s.pieces[player][KING]; b; )
+	{
+		KingMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	pieceMoves(s, player, nextMoves, ci, type);
+}
+
+/***************************************************************************/
+void AI::evasions(const myState & s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	//the king steps out of check or captures the checker
+	KingMove(s, ci.kingSquare, player, nextMoves, ci, type);
+	
+	//the checkMask of a single check only lets the other pieces capture the checker or block it
+	if(ci.checkMask)
+	{
+		pieceMoves(s, player, nextMoves, ci, type);
+	}
+}
+
+/***************************************************************************/
+void AI::pieceMoves(const myState & s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard b;
+	
+	//Find the possible nextMoves for all the pieces
+	
+	//Bishop
+	for(b = s.pieces[player][BISHOP]; b; )
+	{
+		BishopMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	
+	//Queen
+	for(b = s.pieces[player][QUEEN]; b; )
+	{
+		QueenMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	
+	//Rook
+	for(b = s.pieces[player][ROOK]; b; )
+	{
+		RookMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	
+	//Knight
+	for(b = s.pieces[player][KNIGHT]; b; )
+	{
+		KnightMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	
+	//Pawn
+	for(b = s.pieces[player][PAWN]; b; )
+	{
+		PawnMove(s, popLsb(b), player, nextMoves, ci, type);
+	}
+	
+}
+
+
+/************************************************************************************************************/
+bool AI::inCheck(const myState &s, int player)
+{
+	Bitboard king = s.pieces[!player][KING];
+	return king && isSquareAttacked(s, lsb(king), player);
+}
+
+/************************************************************************************************************/
+bool AI::isSquareAttacked(const myState &s, int square, int byColor)
+{
+	//a piece on the square attacks the attackers of its own type
+	const Bitboard *pieces = s.pieces[byColor];
+	Bitboard occupied = s.occupied[0] | s.occupied[1];
+	return (PawnAttacks[!byColor][square] & pieces[PAWN])
+		|| (KnightAttacks[square] & pieces[KNIGHT])
+		|| (KingAttacks[square] & pieces[KING])
+		|| (bishopAttacks(square, occupied) & (pieces[BISHOP] | pieces[QUEEN]))
+		|| (rookAttacks(square, occupied) & (pieces[ROOK] | pieces[QUEEN]));
+}
+
+/************************************************************************************************************/
+//The type of the piece a capture takes, PAWN for en passant
+static int capturedAt(const myState &s, const myMove &m)
+{
+	Bitboard to = squareBB(m.to());
+	for(int type = PAWN; type < KING; type++)
+	{
+		if(s.pieces[!s.sideToMove][type] & to)
+		{
+			return type;
+		}
+	}
+	return PAWN;
+}
+
+/************************************************************************************************************/
+Bitboard AI::attackersTo(const myState &s, int square, Bitboard occupied)
+{
+	//a piece on the square would attack the attackers of its own type
+	return (PawnAttacks[BLACK][square] & s.pieces[WHITE][PAWN])
+		| (PawnAttacks[WHITE][square] & s.pieces[BLACK][PAWN])
+		| (KnightAttacks[square] & (s.pieces[0][KNIGHT] | s.pieces[1][KNIGHT]))
+		| (KingAttacks[square] & (s.pieces[0][KING] | s.pieces[1][KING]))
+		| (bishopAttacks(square, occupied) & (s.pieces[0][BISHOP] | s.pieces[1][BISHOP] | s.pieces[0][QUEEN] | s.pieces[1][QUEEN]))
+		| (rookAttacks(square, occupied) & (s.pieces[0][ROOK] | s.pieces[1][ROOK] | s.pieces[0][QUEEN] | s.pieces[1][QUEEN]));
+}
+
+/************************************************************************************************************/
+int AI::see(const myState &s, const myMove &m)
+{
+	int from = m.from();
+	int to = m.to();
+	int player = s.sideToMove;
+	Bitboard occupied = s.occupied[0] | s.occupied[1];
+	Bitboard diagonal = s.pieces[0][BISHOP] | s.pieces[1][BISHOP] | s.pieces[0][QUEEN] | s.pieces[1][QUEEN];
+	Bitboard straight = s.pieces[0][ROOK] | s.pieces[1][ROOK] | s.pieces[0][QUEEN] | s.pieces[1][QUEEN];
+	
+	//gain[d] is the material won by the side that makes capture d, if the exchange stops after it
+	int gain[32];
+	int d = 0;
+	int attacker = pieceTypeAt(s, from, player);
+	int victim = pieceTypeAt(s, to, !player);
+	if(m.type() == EN_PASSANT)
+	{
+		//en passant, the captured pawn is not on the square
+		victim = PAWN;
+		occupied ^= squareBB(to + (player ? -8 : 8));
+	}
+	gain[0] = victim == NO_PIECE ? 0 : PieceValue[victim];
+	if(m.type() == PROMOTION)
+	{
+		attacker = m.promoteType();
+		gain[0] += PieceValue[attacker] - PieceValue[PAWN];
+	}
+	
+	Bitboard attackers = attackersTo(s, to, occupied);
+	Bitboard fromSet = squareBB(from);
+	int side = player;
+	do
+	{
+		d++;
+		//what the next capture wins if the last piece that captured is taken
+		gain[d] = PieceValue[attacker] - gain[d - 1];
+		if(std::max(-gain[d - 1], gain[d]) < 0)
+		{
+			break;
+		}
+		occupied ^= fromSet;
+		attackers &= occupied;
+		//the sliders behind the piece that captured can now reach the square
+		attackers |= (bishopAttacks(to, occupied) & diagonal & occupied) | (rookAttacks(to, occupied) & straight & occupied);
+		side = !side;
+		
+		//the least valuable attacker of the side to capture
+		fromSet = 0;
+		for(int type = PAWN; type <= KING && !fromSet; type++)
+		{
+			fromSet = attackers & s.pieces[side][type];
+			attacker = type;
+		}
+		fromSet &= 0 - fromSet;
+	} while(fromSet && d < 31);
+	
+	//each side only goes on with the exchange when that is better than stopping
+	while(--d)
+	{
+		gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+	}
+	return gain[0];
+}
+
+/************************************************************************************************************/
+//The squares the pieces of a player can move to for a type of generation
+static Bitboard genTargets(const myState &s, int player, GenType type)
+{
+	switch(type)
+	{
+		case GEN_CAPTURES: return s.occupied[!player];
+		case GEN_QUIETS: return ~(s.occupied[0] | s.occupied[1]);
+		default: return ~s.occupied[player];
+	}
+}
+
+/************************************************************************************************************/
+//The squares a piece other than the king can move to without leaving its king in check
+static Bitboard legalTargets(const myCheckInfo &ci, int square)
+{
+	if(ci.pinned & squareBB(square))
+	{
+		return ci.checkMask & LineSquares[ci.kingSquare][square];
+	}
+	return ci.checkMask;
+}
+
+/************************************************************************************************************/
+//Adds a move of the given type from 'from' to every square in targets
+static void addMoves(int from, Bitboard targets, myMoves &nextMoves, MoveType type = NORMAL)
+{
+	while(targets)
+	{
+		nextMoves.push_back(myMove::make(from, popLsb(targets), type));
+	}
+}
+
+/************************************************************************************************************/
+//Adds the four promotions of a pawn moving from 'from' to 'to'
+static void addPromotions(int from, int to, myMoves &nextMoves)
+{
+	nextMoves.push_back(myMove::make(from, to, PROMOTION, QUEEN));
+	nextMoves.push_back(myMove::make(from, to, PROMOTION, KNIGHT));
+	nextMoves.push_back(myMove::make(from, to, PROMOTION, BISHOP));
+	nextMoves.push_back(myMove::make(from, to, PROMOTION, ROOK));
+}
+
+/************************************************************************************************************/
+
+bool AI::KingMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard occupied = s.occupied[0] | s.occupied[1];
+	Bitboard targets = KingAttacks[square] & genTargets(s, player, type);
+	
+	//the king can not move to an attacked square, the sliders that check it also attack the squares behind it
+	Bitboard safe = 0;
+	for(Bitboard b = targets; b; )
+	{
+		int to = popLsb(b);
+		if(!(attackersTo(s, to, occupied ^ squareBB(square)) & s.occupied[!player]))
+		{
+			safe |= squareBB(to);
+		}
+	}
+	addMoves(square, safe, nextMoves);
+	
+	//castling, the king and the rook must not have moved, the squares between them must be empty
+	//and the king must not be in check or pass an attacked square
+	int rank = rankOf(square);
+	if(!ci.checkers && type != GEN_CAPTURES)
+	{
+		//left side of board
+		if((s.castling & (player ? BLACK_OOO : WHITE_OOO))
+			&& !(occupied & (squareBB(makeSquare(1, rank)) | squareBB(makeSquare(2, rank)) | squareBB(makeSquare(3, rank))))
+			&& !isSquareAttacked(s, makeSquare(3, rank), !player) && !isSquareAttacked(s, makeSquare(2, rank), !player))
+		{
+			addMoves(square, squareBB(makeSquare(2, rank)), nextMoves, CASTLING);
+		}
+		//right side of board
+		if((s.castling & (player ? BLACK_OO : WHITE_OO))
+			&& !(occupied & (squareBB(makeSquare(5, rank)) | squareBB(makeSquare(6, rank))))
+			&& !isSquareAttacked(s, makeSquare(5, rank), !player) && !isSquareAttacked(s, makeSquare(6, rank), !player))
+		{
+			addMoves(square, squareBB(makeSquare(6, rank)), nextMoves, CASTLING);
+		}
+	}
+	return (targets & s.pieces[!player][KING]) != 0;
+}
+
+/*********************************************************************************************************************/
+
+bool AI::QueenMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard targets = queenAttacks(square, s.occupied[0] | s.occupied[1]) & genTargets(s, player, type) & legalTargets(ci, square);
+	addMoves(square, targets, nextMoves);
+	return (targets & s.pieces[!player][KING]) != 0;
+}
+
+/********************************************************************************************************/
+
+bool AI::BishopMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard targets = bishopAttacks(square, s.occupied[0] | s.occupied[1]) & genTargets(s, player, type) & legalTargets(ci, square);
+	addMoves(square, targets, nextMoves);
+	return (targets & s.pieces[!player][KING]) != 0;
+}
+
+/***********************************************************************************************************/
+
+bool AI::RookMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard targets = rookAttacks(square, s.occupied[0] | s.occupied[1]) & genTargets(s, player, type) & legalTargets(ci, square);
+	addMoves(square, targets, nextMoves);
+	return (targets & s.pieces[!player][KING]) != 0;
+}
+
+/**********************************************************************************************************/
+bool AI::KnightMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard targets = KnightAttacks[square] & genTargets(s, player, type) & legalTargets(ci, square);
+	addMoves(square, targets, nextMoves);
+	return (targets & s.pieces[!player][KING]) != 0;
+}
+
+/*********************************************************************************/
+bool AI::PawnMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+{
+	Bitboard occupied = s.occupied[0] | s.occupied[1];
+	Bitboard legal = legalTargets(ci, square);
+	//white pawns move towards rank 0, black pawns towards rank 7
+	int forward = player ? 8 : -8;
+	int startRank = player ? 1 : 6;
+	int lastRank = player ? 6 : 1;
+	int rank = rankOf(square);
+	
+	//move forward
+	int to = square + forward;
+	if(!(occupied & squareBB(to)))
+	{
+		//promotion
+		if(rank == lastRank)
+		{
+			if(type != GEN_QUIETS && (legal & squareBB(to)))
 			{
-				inTheCheck = KnightMove(s, file, rank, player, nextMoves);
-				
+				addPromotions(square, to, nextMoves);
 			}
+		}
+		else if(type != GEN_CAPTURES)
+		{
+			addMoves(square, squareBB(to) & legal, nextMoves);
 			
-			//Pawn
-			if((!player && s.board[rank][file]=='P') || (player && s.board[rank][file]=='p'))
-			{
-				inTheCheck = PawnMove(s, file, rank, player, nextMoves);
-			}
-			if(inTheCheck == true)
+			//first move, can move forward 2
+			if(rank == startRank && !(occupied & squareBB(to + forward)))
 			{
-				return true;
+				addMoves(square, squareBB(to + forward) & legal, nextMoves);
 			}
 		}
 	}
 	
-	return inTheCheck;
+	//Capture
+	Bitboard targets = PawnAttacks[player][square] & s.occupied[!player] & legal;
+	if(type == GEN_QUIETS)
+	{
+		return false;
+	}
+	if(rank == lastRank)
+	{
+		for(Bitboard b = targets; b; )
+		{
+			addPromotions(square, popLsb(b), nextMoves);
+		}
+	}
+	else
+	{
+		addMoves(square, targets, nextMoves);
+	}
+	
+	//En passant, two pawns leave the rank of the king at once, so the king is looked at after the capture
+	if(s.epSquare != NO_SQUARE && (PawnAttacks[player][square] & squareBB(s.epSquare)))
+	{
+		int capSquare = s.epSquare - forward;
+		Bitboard after = (occupied ^ squareBB(square) ^ squareBB(capSquare)) | squareBB(s.epSquare);
+		if(ci.kingSquare == NO_SQUARE
+			|| !(attackersTo(s, ci.kingSquare, after) & s.occupied[!player] & ~squareBB(capSquare)))
+		{
+			addMoves(square, squareBB(s.epSquare), nextMoves, EN_PASSANT);
+		}
+	}
 	
+	return (targets & s.pieces[!player][KING]) != 0;
 }
 
-/************************************************************************************************************/
+/*******************************************************************************************************/
+char AI::pieceAt(const myState &s, int square)
+{
+	for(int player = 0; player < 2; player++)
+	{
+		int type = pieceTypeAt(s, square, player);
+		if(type != NO_PIECE)
+		{
+			//Black pieces use lowercase letters
+			return player ? tolower(pieceTypeChar(type)) : pieceTypeChar(type);
+		}
+	}
+	return ' ';
+}
 
-bool AI::KingMove(myState s, int file, int rank, int player, myMoves &nextMoves, bool inCheck)
+/*******************************************************************************************************/
+int AI::pieceTypeAt(const myState &s, int square, int player)
 {
-	myMove move;
-	move.player = player;
-	move.promoteType = '\0';
-	move.fromFile = file;
-	move.fromRank = rank;
-	bool checkmate = false;
-	for(int i = -1; i <= 1; i++)
-	{
-		for(int j = -1; j <= 1; j++)
-		{
-			int toFile = file + j;
-			int toRank = rank + i;
-			if( toRank >= 0 && toRank <=7 && toFile >= 0 && toFile <=7 &&
-			   (s.board[toRank][toFile] == ' '|| (!player && isBlack(s.board[toRank][toFile]))
-			   || (player && isWhite(s.board[toRank][toFile])))&& (i != 0 || j != 0))
-			{
-				move.toFile = toFile;
-				move.toRank = toRank;
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-				nextMoves.push_back(move);
-			}
+	Bitboard b = squareBB(square);
+	if(!(s.occupied[player] & b))
+	{
+		return NO_PIECE;
+	}
+	for(int type = PAWN; type < KING; type++)
+	{
+		if(s.pieces[player][type] & b)
+		{
+			return type;
+		}
+	}
+	return KING;
+}
+
+/*******************************************************************************************************/
+//If a stored score is deep enough and its bound settles the node for the window alpha, beta
+static bool ttCutoff(const TTData &tte, int depth, int alpha, int beta)
+{
+	if(tte.depth < depth)
+	{
+		return false;
+	}
+	return tte.bound() == BOUND_EXACT
+		|| (tte.bound() == BOUND_LOWER && tte.score >= beta)
+		|| (tte.bound() == BOUND_UPPER && tte.score <= alpha);
+}
+
+/*******************************************************************************************************/
+//Writes a packed move in coordinates, like e7e8q
+static void moveText(uint16_t packed, char *text)
+{
+	myMove m(packed);
+	text[0] = 'a' + m.fromFile();
+	text[1] = '8' - m.fromRank();
+	text[2] = 'a' + m.toFile();
+	text[3] = '8' - m.toRank();
+	text[4] = m.type() == PROMOTION ? tolower(pieceTypeChar(m.promoteType())) : '\0';
+	text[5] = '\0';
+}
+
+/*******************************************************************************************************/
+//The principal variation of a ply is its move followed by the line of the next ply
+static void updatePv(mySearch &ss, size_t ply, const myMove &m)
+{
+	ss.pv[ply][ply] = m.data;
+	for(int i = ply + 1; i < ss.pvLength[ply + 1]; i++)
+	{
+		ss.pv[ply][i] = ss.pv[ply + 1][i];
+	}
+	ss.pvLength[ply] = std::max(ss.pvLength[ply + 1], int(ply + 1));
+}
+
+/*******************************************************************************************************/
+//The move of the last principal variation at the current ply, 0 when the moves played differ from it
+static uint16_t lastPvMove(const mySearch &ss)
+{
+	size_t depth = ss.undoStack.size() - ss.rootPly;
+	if(depth >= ss.lastPv.size())
+	{
+		return 0;
+	}
+	for(size_t i = 0; i < depth; i++)
+	{
+		if(ss.undoStack[ss.rootPly + i].move.data != ss.lastPv[i])
+		{
+			return 0;
+		}
+	}
+	return ss.lastPv[depth];
+}
+
+/*******************************************************************************************************/
+myMove AI::nextMove(const myState & oldState)
+{
+	myMove mmove;
+	
+	//every thread plays its moves on its own copy of the state and takes them back
+	for(int i = 0; i < threadCount; i++)
+	{
+		searches[i].state = oldState;
+		searches[i].undoStack = gameMoves;
+		searches[i].nodes = 0;
+		searches[i].splitPoint = NULL;
+		searches[i].nullMinPly = 0;
+		searches[i].rootPly = gameMoves.size();
+		searches[i].lastPv.clear();
+		//the plies of the killers change with every game move
+		memset(searches[i].killers, 0, sizeof(searches[i].killers));
+	}
+	mySearch &ss = searches[0];
+	
+	//Find all the possible moves for current state
+	tt.newSearch();
+	TTData tte;
+	uint16_t hashMove = tt.probe(oldState.key, tte) ? tte.move : 0;
+	myMoveScores &newMoves = orderedMoves(ss, playerID(), hashMove);
+	time_t maxTime = timeHave();
+	int score = 0;
+	
+	//if there is no legal move
+	if(newMoves.size() == 0)
+	{
+		printf("No legal move!\n");
+		return myMove();
+	}
+	//the move played if the time runs out before the first depth is done
+	mmove = newMoves[0].move;
+	
+	//the helper threads search, or wait for split points to join, until this thread has its move
+	stopTime = maxTime;
+	stopSearch = false;
+	std::vector<std::thread> helpers;
+	for(int i = 1; i < threadCount; i++)
+	{
+		if(backend == YBW)
+		{
+			helpers.push_back(std::thread(&AI::idleLoop, this, std::ref(searches[i]), (mySplitPoint*)NULL));
+		}
+		else
+		{
+			helpers.push_back(std::thread(&AI::helperSearch, this, std::ref(searches[i])));
+		}
+	}
+	
+	//the nodes of the last depth, for the effective branching factor
+	long lastNodes = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	//Time limited ID-DLMM miniMax
+	for(int depth = 1; maxTime > time(NULL) && depth <= searchDepth; depth++) {
+		long startNodes = ss.nodes;
+		//search the best move of the last depth first
+		for(size_t i = 1; depth > 1 && i < newMoves.size(); i++) {
+			if(newMoves[i].move.data == mmove.data) {
+				std::swap(newMoves[0], newMoves[i]);
+			}
+		}
+		ageHistory(ss);
+		score = aspirationSearch(ss, depth, score);
+		//a depth stopped by the clock is not used
+		if(stopped(ss))
+		{
+			break;
+		}
+		mmove = ss.rootMove;
+		
+		//the nodes are counted on the main thread. The effective branching factor is how many
+		//times more nodes a depth takes than the last one
+		long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		long depthNodes = ss.nodes - startNodes;
+		printf("depth: %d, score: %d, nodes: %ld, nps: %ld, time: %ldms", depth, score, ss.nodes,
+			ss.nodes * 1000 / std::max(ms, 1L), ms);
+		if(lastNodes > 0)
+		{
+			printf(", effective branching factor: %.2f", double(depthNodes) / lastNodes);
+		}
+		lastNodes = depthNodes;
+		printf(", pv:");
+		for(size_t i = 0; i < ss.lastPv.size(); i++)
+		{
+			char text[6];
+			moveText(ss.lastPv[i], text);
+			printf(" %s", text);
+		}
+		printf("\n");
+	}
+	
+	stopSearch = true;
+	long nodes = ss.nodes;
+	for(size_t i = 0; i < helpers.size(); i++)
+	{
+		helpers[i].join();
+		nodes += searches[i + 1].nodes;
+	}
+	printf("nodes: %ld (%d threads)\n", nodes, threadCount);
+	
+	return mmove;
+}
+
+/*******************************************************************************************************/
+int AI::aspirationSearch(mySearch &ss, int depth, int lastScore)
+{
+	int alpha = -10000000;
+	int beta = 10000000;
+	int delta = ASPIRATION_WINDOW;
+	//the first depth has no score to center the window on
+	if(depth > 1)
+	{
+		alpha = std::max(lastScore - delta, -10000000);
+		beta = std::min(lastScore + delta, 10000000);
+	}
+	
+	//the root has no extensions yet
+	ss.extended[ss.undoStack.size()] = 0;
+	while(true)
+	{
+		int score = search<ROOT>(ss, alpha, beta, depth);
+		if(stopped(ss))
+		{
+			return score;
 		}
-	}
-				
-	//castling for white
-	if(rank == 7 && file == 4 && !s.hasMoved[7][4] && !inCheck)
-	{
-		//left side of board
-		if(s.board[7][0] == 'R' && s.board[7][1] == ' ' && s.board[7][2] == ' ' && s.board[7][3] == ' ' && !s.hasMoved[7][0])
+		//the true score is outside the window, widen it on that side and search again
+		if(score <= alpha)
 		{
-			move.toFile = 2;
-			move.toRank = 7;
-			if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-			{
-				checkmate = true;
-			}
-			nextMoves.push_back(move);
+			alpha = std::max(score - delta, -10000000);
 		}
-		//right side of board
-		if(s.board[7][7] == 'R' && s.board[7][6] == ' ' && s.board[7][5] == ' ' && !s.hasMoved[7][7])
+		else if(score >= beta)
 		{
-			move.toFile = 6;
-			move.toRank = 7;
-			if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-			{
-				checkmate = true;
-			}
-			nextMoves.push_back(move);
+			beta = std::min(score + delta, 10000000);
 		}
-	}
-				
-	//castling for black
-	if(rank == 0 && file == 4 && !s.hasMoved[0][4] && !inCheck)
-	{
-		//left side of board
-		if(s.board[0][0] == 'r' && s.board[0][1] == ' ' && s.board[0][2] == ' ' && s.board[0][3] == ' ' && !s.hasMoved[0][0])
+		else
 		{
-			move.toFile = 2;
-			move.toRank = 0;
-			if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
+			//the principal variation of the depth orders the moves along it in the next one
+			ss.lastPv.clear();
+			for(int i = ss.rootPly; i < ss.pvLength[ss.rootPly]; i++)
 			{
-				checkmate = true;
+				ss.lastPv.push_back(ss.pv[ss.rootPly][i]);
 			}
-			nextMoves.push_back(move);
+			return score;
 		}
-		//right side of board
-		if(s.board[0][7] == 'r' && s.board[0][6] == ' ' && s.board[0][5] == ' ' && !s.hasMoved[0][7])
+		delta *= 2;
+	}
+}
+
+/*******************************************************************************************************/
+void AI::helperSearch(mySearch &ss)
+{
+	//the moves are in the buffer of the root ply of this thread, so they are not shared
+	myMoveScores &rootMoves = orderedMoves(ss, playerID());
+	myMove bestMove = myMove();
+	int score = 0;
+	
+	//half of the helpers search one depth ahead, so the threads do not all search the same tree
+	for(int depth = 1 + ss.id % 2; !stopSearch.load(std::memory_order_relaxed) && depth < MAX_PLY / 2; depth++)
+	{
+		for(size_t i = 1; depth > 1 && i < rootMoves.size(); i++)
 		{
-			move.toFile = 6;
-			move.toRank = 0;
-			if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
+			if(rootMoves[i].move.data == bestMove.data)
 			{
-				checkmate = true;
+				std::swap(rootMoves[0], rootMoves[i]);
 			}
-			nextMoves.push_back(move);
 		}
+		ageHistory(ss);
+		score = aspirationSearch(ss, depth, score);
+		bestMove = ss.rootMove;
 	}
-	return checkmate;
 }
 
-/*********************************************************************************************************************/
-
-bool AI::QueenMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/*******************************************************************************************************/
+void AI::historyBonus(mySearch &ss, const myMove &m, int depthleft)
 {
-	bool checkmate0 = false, checkmate1 = false;
-	checkmate0 = BishopMove(s, file, rank, player, nextMoves);
-	checkmate1 = RookMove(s, file, rank, player, nextMoves);
-	
-	return (checkmate0 || checkmate1);
+	int &h = ss.history[ss.state.sideToMove][m.from()][m.to()];
+	int bonus = depthleft * depthleft;
+	h += bonus - h * bonus / HISTORY_MAX;
 }
 
-/********************************************************************************************************/
+/*******************************************************************************************************/
+void AI::quietCutoff(mySearch &ss, const myMove &m)
+{
+	size_t ply = ss.undoStack.size();
+	if(m.data != ss.killers[ply][0].data)
+	{
+		ss.killers[ply][1] = ss.killers[ply][0];
+		ss.killers[ply][0] = m;
+	}
+	if(ply > 0 && ss.undoStack[ply - 1].moved != NO_PIECE)
+	{
+		const myUndo &last = ss.undoStack[ply - 1];
+		ss.counterMoves[!ss.state.sideToMove][last.moved][last.move.to()] = m;
+	}
+}
 
-bool AI::BishopMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/*******************************************************************************************************/
+void AI::ageHistory(mySearch &ss)
 {
-	myMove move;
-	move.player = player;
-	move.promoteType = '\0';
-	move.fromFile = file;
-	move.fromRank = rank;
-	bool checkmate = false;
-	
-	bool blocked[4] = {false, false, false, false};
-	int dX[4] = {1, -1, 1, -1};
-	int dY[4] = {1, -1, -1, 1};
-	
-	for(int d = 0; d <= 3; d++ )
-	{ 
-		for(int i = 1; i <=7; i++)
+	for(int player = 0; player < 2; player++)
+	{
+		for(int from = 0; from < 64; from++)
 		{
-			if(!blocked[d])
+			for(int to = 0; to < 64; to++)
 			{
-				int toFile = file + dX[d] * i;
-				int toRank = rank + dY[d] * i;
-				if((toFile>= 0) && (toFile<=7) && (toRank >=0) && (toRank <=7))
-				{
-					if(s.board[toRank][toFile] == ' ')
-					{
-						move.toFile = toFile;
-						move.toRank = toRank;
-						nextMoves.push_back(move);
-					}
-					else
-					{
-						blocked[d] = true;
-						if((!player && isBlack(s.board[toRank][toFile])) || (player && isWhite(s.board[toRank][toFile])))
-						{
-							move.toFile = toFile;
-							move.toRank = toRank;
-							if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-							{
-								checkmate = true;
-							}
-						nextMoves.push_back(move);
-						}
-					}
-					
-				}
-				else
-				{
-					blocked[d] = true;
-				}
+				ss.history[player][from][to] /= 2;
 			}
 		}
 	}
-	
-	return checkmate;					
-		
 }
 
-/***********************************************************************************************************/
+/*******************************************************************************************************/
+void AI::checkTime(const mySearch &ss)
+{
+	if(ss.id == 0 && (ss.nodes & 1023) == 0 && time(NULL) >= stopTime)
+	{
+		stopSearch = true;
+	}
+}
 
-bool AI::RookMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/*******************************************************************************************************/
+bool AI::stopped(const mySearch &ss)
 {
-	myMove move;
-	move.player = player;
-	move.promoteType = '\0';
-	move.fromFile = file;
-	move.fromRank = rank;
-	
-	bool checkmate = false;
-	
-	bool blocked[4] = {false, false, false, false};
-	int dX[4] = {0, 0, 1, -1};
-	int dY[4] = {1, -1, 0, 0};
+	if(stopSearch.load(std::memory_order_relaxed))
+	{
+		return true;
+	}
+	for(const mySplitPoint *sp = ss.splitPoint; sp != NULL; sp = sp->parent)
+	{
+		if(sp->cutoff.load(std::memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/*******************************************************************************************************/
+int AI::extension(mySearch &ss, int singular)
+{
+	size_t ply = ss.undoStack.size();
+	const myUndo &u = ss.undoStack.back();
+	int extension = singular;
 	
-	for(int d = 0; d <= 3; d++ )
-	{ 
-		for(int i = 1; i <=7; i++)
+	if(inCheck(ss.state, !ss.state.sideToMove))
+	{
+		extension = std::max(extension, CHECK_EXTENSION);
+	}
+	//the last game move is kept under the root with what it captured, so a recapture of it at the first ply is extended too
+	if(u.captured != NO_PIECE && ply >= 2)
+	{
+		const myUndo &before = ss.undoStack[ply - 2];
+		if(before.captured != NO_PIECE && u.move.to() == before.move.to())
 		{
-			if(!blocked[d])
-			{
-				int toFile = file + dX[d]*i;
-				int toRank = rank + dY[d]*i;
-				if((toFile>=0) && (toFile<=7) && (toRank>=0) && (toRank <=7))
-				{
-					if(s.board[toRank][toFile] == ' ')
-					{
-						move.toFile = toFile;
-						move.toRank = toRank;
-						nextMoves.push_back(move);
-					}
-					else
-					{
-						blocked[d] = true;
-						if((!player && isBlack(s.board[toRank][toFile])) || (player && isWhite(s.board[toRank][toFile])))
-						{
-							move.toFile = toFile;
-							move.toRank = toRank;
-							if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-							{
-								checkmate = true;
-							}
-							nextMoves.push_back(move);
-						}
-					}	
-				}
-				else
-				{
-					blocked[d] = true;
-				}
-			}
+			extension = std::max(extension, RECAPTURE_EXTENSION);
 		}
 	}
+	if(u.moved == PAWN && u.move.toRank() == (ss.state.sideToMove == BLACK ? 1 : 6))
+	{
+		extension = std::max(extension, PAWN_PUSH_EXTENSION);
+	}
 	
-	return checkmate;
+	//the line is one ply deeper for every ONE_PLY of extensions, until the budget is spent
+	ss.extended[ply] = std::min(ss.extended[ply - 1] + extension, EXTENSION_BUDGET * ONE_PLY);
+	return ss.extended[ply] / ONE_PLY - ss.extended[ply - 1] / ONE_PLY;
 }
 
-/**********************************************************************************************************/
-bool AI::KnightMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/*******************************************************************************************************/
+int AI::searchLateMove(mySearch &ss, const myMove &m, int moveCount, int depthleft, int alpha, int beta, bool pvNode, bool checked)
 {
-	myMove move;
-	move.player = player;
-	move.promoteType = '\0';
-	move.fromFile = file;
-	move.fromRank = rank;
-	bool checkmate = false;
-	
-	for(int i = -2; i<=2; i++)
-	{
-		for(int j = -2; j<=2; j++)
-		{
-			int toRank = rank + i;
-			int toFile = file + j;
-			if(toRank >= 0 && toRank <= 7 && toFile >=0 && toFile <=7 &&
-				i != 0 && j != 0 && (abs(j) != abs(i)) &&
-				(s.board[toRank][toFile] == ' '
-				|| (!player && isBlack(s.board[toRank][toFile]))
-				|| (player && isWhite(s.board[toRank][toFile]))))
-			{
-				move.toFile = toFile;
-				move.toRank = toRank;
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-				nextMoves.push_back(move);
-			}
-		}
+	bool quiet = isQuiet(ss.state, m);
+	makeMove(ss, m);
+	int newDepth = depthleft - 1 + extension(ss, 0);
+	
+	//Late move reductions: a quiet move ordered late rarely beats alpha, so it is first searched
+	//less deep. Not when the move escapes or gives a check
+	int reduction = 0;
+	if(quiet && !checked && depthleft >= LMR_MIN_DEPTH && moveCount > LMR_FULL_MOVES + pvNode
+		&& !inCheck(ss.state, !ss.state.sideToMove))
+	{
+		reduction = Reductions[std::min(depthleft, 63)][std::min(moveCount, 63)] - pvNode;
+		reduction = std::max(std::min(reduction, newDepth - 1), 0);
+	}
+	
+	//the younger brothers only have to be proved worse than alpha, with a zero window
+	int score = alpha + 1;
+	if(reduction > 0)
+	{
+		score = -search<NON_PV>(ss, -alpha - 1, -alpha, newDepth - reduction);
+	}
+	if(score > alpha && !stopped(ss))
+	{
+		score = -search<NON_PV>(ss, -alpha - 1, -alpha, newDepth);
+	}
+	if(pvNode && score > alpha && score < beta && !stopped(ss))
+	{
+		score = -search<PV>(ss, -beta, -alpha, newDepth);
 	}
-	return checkmate;
+	unmakeMove(ss);
+	return score;
 }
 
-/*********************************************************************************/
-bool AI::PawnMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/*******************************************************************************************************/
+bool AI::canSplit(const mySearch &ss, int depthleft)
 {
-	myMove move;
-	move.player = player;
-	move.promoteType = '\0';
-	move.fromFile = file;
-	move.fromRank = rank;
-	bool checkmate = false;
+	return backend == YBW
+		&& depthleft >= YBW_MIN_DEPTH
+		&& idleThreads.load(std::memory_order_relaxed) > 0
+		&& ss.splitPoints.size() < YBW_MAX_SPLITS;
+}
+
+/*******************************************************************************************************/
+int AI::split(mySearch &ss, const myMoveScores &moves, size_t first, int depthleft, int alpha, int beta, bool pvNode, bool checked, myMove &bestMove)
+{
+	mySplitPoint sp;
+	sp.parent = ss.splitPoint;
+	sp.state = ss.state;
+	sp.undoStack = ss.undoStack;
+	sp.moves = &moves;
+	sp.next = first;
+	sp.depthleft = depthleft;
+	sp.pvNode = pvNode;
+	sp.checked = checked;
+	sp.first = first;
+	sp.extended = ss.extended[ss.undoStack.size()];
+	sp.alpha = alpha;
+	sp.beta = beta;
+	sp.score = -1000000;
+	sp.bestMove = bestMove;
+	sp.workers = 1;
+	sp.cutoff = false;
+	sp.open = true;
+	
+	//the other threads can join the split point from now on
+	{
+		std::lock_guard<std::mutex> guard(splitLock);
+		ss.splitPoints.push_back(&sp);
+	}
+	openSplits++;
+	
+	searchSplitPoint(ss, &sp);
+	//the owner only leaves its moves when there are none left or the search stopped
+	closeSplit(&sp);
+	sp.workers--;
+	
+	//help the threads still searching the moves of the split point until they are done,
+	//the split point is then off the list
+	idleLoop(ss, &sp);
+	
+	//helping may have left the thread on another state
+	ss.state = sp.state;
+	ss.undoStack = sp.undoStack;
+	bestMove = sp.bestMove;
+	return sp.score;
+}
+
+/*******************************************************************************************************/
+void AI::searchSplitPoint(mySearch &ss, mySplitPoint *sp)
+{
+	mySplitPoint *parent = ss.splitPoint;
+	ss.splitPoint = sp;
 	
-	//move forward for white Pawn
-	if((!player) && (s.board[rank][file] == 'P') && (rank > 0))
+	while(true)
 	{
-		if(s.board[rank-1][file] == ' ')
+		myMove move;
+		int alpha, beta, moveCount;
 		{
-			move.toFile = file;
-			move.toRank = rank-1;
-			//promotion
-			if(rank == 1)
-			{
-				/* change promotion type before adding the move to 'nextMoves' */
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				/* reset the promoteType to '\0' for the possible moves */
-				move.promoteType = '\0';
-			}
-			else
+			std::lock_guard<std::mutex> guard(sp->lock);
+			if(sp->next >= sp->moves->size() || stopped(ss))
 			{
-				nextMoves.push_back(move);
+				break;
 			}
-			
-			//first move, can move forward 2
-			if((rank == 6) && (s.board[rank-2][file] == ' '))
+			//the eldest brother was searched before the split
+			moveCount = int(sp->next - sp->first) + 2;
+			move = (*sp->moves)[sp->next++].move;
+			alpha = sp->alpha;
+			beta = sp->beta;
+			if(sp->next >= sp->moves->size())
 			{
-				move.toFile = file;
-				move.toRank = rank-2;
-				nextMoves.push_back(move);
+				closeSplit(sp);
 			}
 		}
-				
-		//Capture
-		if((file < 7) && (isBlack(s.board[rank-1][file+1]))) //right
+		
+		//a thread that joins the split point has not searched the line to it
+		ss.extended[ss.undoStack.size()] = sp->extended;
+		int score = searchLateMove(ss, move, moveCount, sp->depthleft, alpha, beta, sp->pvNode, sp->checked);
+		if(stopped(ss))
 		{
-			move.toFile = file+1;
-			move.toRank = rank-1;
-			//promotion
-			if(rank == 1)
-			{
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				move.promoteType = '\0';
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-			}
-			else
-			{
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-				nextMoves.push_back(move);
-			}
+			break;
 		}
-		if((file> 0) && (isBlack(s.board[rank-1][file-1]))) //left
+		
+		std::lock_guard<std::mutex> guard(sp->lock);
+		if(score > sp->score)
 		{
-			move.toFile = file-1;
-			move.toRank = rank-1;
-			//promotion
-			if(rank == 1)
-			{
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				move.promoteType = '\0';
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-			}
-			else
-			{
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-				nextMoves.push_back(move);
-			}
+			sp->score = score;
+			sp->bestMove = move;
 		}
-		//En passant
-		if(s.lastMoves.size() > 0 && file < 7 && rank == 3 && s.board[rank][file+1] == 'p'
-			&& (s.lastMoves[0].toFile - 1) == file && ( 8 - s.lastMoves[0].toRank)== rank
-			&& (8 - s.lastMoves[0].fromRank) == 1) //right
+		if(sp->score >= sp->beta)
 		{
-			move.toFile = file + 1;
-			move.toRank = rank - 1;
-			nextMoves.push_back(move);
-		
+			sp->cutoff = true;
+			closeSplit(sp);
 		}
-		
-		if(s.lastMoves.size() > 0 && file > 0 && rank == 3 && s.board[rank][file - 1] == 'p'
-			&& (s.lastMoves[0].toFile - 1) == file && ( 8 - s.lastMoves[0].toRank) == rank
-			&& ( 8 - s.lastMoves[0].fromRank) == 1) //left
+		else if(sp->score > sp->alpha)
 		{
-			move.toFile = file - 1;
-			move.toRank = rank - 1;
-			nextMoves.push_back(move);
+			sp->alpha = sp->score;
 		}
+	}
 	
+	ss.splitPoint = parent;
+}
+
+/*******************************************************************************************************/
+void AI::closeSplit(mySplitPoint *sp)
+{
+	if(sp->open.exchange(false))
+	{
+		openSplits--;
+	}
+}
+
+/*******************************************************************************************************/
+void AI::idleLoop(mySearch &ss, mySplitPoint *master)
+{
+	if(master == NULL)
+	{
+		idleThreads++;
 	}
-	//Pawn for Black Player
-	if(player && (s.board[rank][file] == 'p') && (rank < 7))
+	
+	while(true)
 	{
-		
-		//move forward
-		if(s.board[rank+1][file] == ' ')
+		//threads only join with splitLock held, so a master with no workers under it is done for good
+		if(master != NULL && master->workers.load() == 0)
 		{
-			move.toFile = file;
-			move.toRank = rank+1;
-			//promotion
-			if(rank == 6)
-			{
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				move.promoteType = '\0';
-			}
-			else
-			{
-				nextMoves.push_back(move);
-			}
-			
-			//first move, can move forward 2
-			if(rank == 1 && s.board[rank+2][file] == ' ')
+			std::lock_guard<std::mutex> guard(splitLock);
+			if(master->workers.load() == 0)
 			{
-				move.toFile = file;
-				move.toRank = rank+2;
-				nextMoves.push_back(move);
+				ss.splitPoints.pop_back();
+				break;
 			}
 		}
+		if(master == NULL && stopSearch.load(std::memory_order_relaxed))
+		{
+			break;
+		}
 		
-		//Capture
-		if(file < 7 && isWhite(s.board[rank+1][file+1])) //right
+		//the lock is only taken when there is a split point to join, the threads searching need it
+		mySplitPoint *sp = NULL;
+		if(openSplits.load(std::memory_order_relaxed) > 0)
 		{
-			move.toFile = file+1;
-			move.toRank = rank+1;
-			//promotion
-			if(rank == 6)
-			{
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				move.promoteType = '\0';
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-			}
-			else
+			std::lock_guard<std::mutex> guard(splitLock);
+			//steal from the other threads in turn, the oldest split point first as it has the most work left
+			for(int t = 1; t < threadCount && sp == NULL; t++)
 			{
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
+				const mySearch &victim = searches[(ss.id + t) % threadCount];
+				for(size_t i = 0; i < victim.splitPoints.size() && sp == NULL; i++)
 				{
-					checkmate = true;
+					mySplitPoint *candidate = victim.splitPoints[i];
+					bool underMaster = master == NULL;
+					bool cut = false;
+					for(const mySplitPoint *p = candidate; p != NULL; p = p->parent)
+					{
+						underMaster = underMaster || p == master;
+						cut = cut || p->cutoff.load(std::memory_order_relaxed);
+					}
+					if(underMaster && !cut && candidate->open.load())
+					{
+						sp = candidate;
+						sp->workers++;
+					}
 				}
-				nextMoves.push_back(move);
 			}
 		}
-		if(file > 0 && isWhite(s.board[rank+1][file-1])) //left
+		
+		if(sp == NULL)
 		{
-			move.toFile = file-1;
-			move.toRank = rank+1;
-			//promotion
-			if(rank == 6)
-			{
-				move.promoteType = 'Q';
-				nextMoves.push_back(move);
-				move.promoteType = 'N';
-				nextMoves.push_back(move);
-				move.promoteType = 'B';
-				nextMoves.push_back(move);
-				move.promoteType = 'R';
-				nextMoves.push_back(move);
-				move.promoteType = '\0';
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-			}
-			else
+			//the main thread may wait here for the helpers of its split point, it still watches the clock
+			if(ss.id == 0 && time(NULL) >= stopTime)
 			{
-				if( (!player && s.board[move.toRank][move.toFile] == 'k') || (player && s.board[move.toRank][move.toFile] == 'K'))
-				{
-					checkmate = true;
-				}
-				nextMoves.push_back(move);
+				stopSearch = true;
 			}
+			std::this_thread::yield();
+			continue;
 		}
-		//En passant
-		if(s.lastMoves.size() > 0 && file < 7 && rank == 4 && s.board[rank][file+1] == 'P'
-			&& (s.lastMoves[0].toFile - 1) == file && (8 - s.lastMoves[0].toRank) == rank
-			&& (8 - s.lastMoves[0].fromRank) == 6 ) //right
+		
+		if(master == NULL)
 		{
-			move.toFile = file + 1;
-			move.toRank = rank + 1;
-			nextMoves.push_back(move);
+			idleThreads--;
 		}
-		
-		if(s.lastMoves.size() > 0 && file > 0 && rank == 4 && s.board[rank][file - 1] == 'P'
-			&& (s.lastMoves[0].toFile - 1) == file && (8 - s.lastMoves[0].toRank) == rank
-			&& (8 - s.lastMoves[0].fromRank) == 6) //left
+		ss.state = sp->state;
+		ss.undoStack = sp->undoStack;
+		searchSplitPoint(ss, sp);
+		sp->workers--;
+		if(master == NULL)
 		{
-			move.toFile = file - 1;
-			move.toRank = rank + 1;
-			nextMoves.push_back(move);
+			idleThreads++;
 		}
 	}
 	
-	return checkmate;
-}
-			
-
-/***********************************************************************************************************/
-
-/*******************************************************************************************************/
-bool AI::isWhite(char c)
-{
-	//White pieces are upperclass
-	if(c >= 'A' && c <= 'Z')
+	if(master == NULL)
 	{
-		return true;
+		idleThreads--;
 	}
-	
-	return false;
 }
 
-/*******************************************************************************************************/
-bool AI::isBlack(char c)
+/**********************************************************************************************************/
+//Gives the next move of the root, the root moves are ordered once for the whole search
+static bool pickRootMove(const myMoveScores &rootMoves, size_t &next, myMove &m)
 {
-	//Black pieces are lowerclass
-	if(c >= 'a' && c <= 'z')
+	if(next >= rootMoves.size())
 	{
-		return true;
+		return false;
 	}
-	
-	return false;
+	m = rootMoves[next++].move;
+	return true;
 }
 
-/*******************************************************************************************************/
-myMove AI::nextMove(const myState & oldState)
+/**********************************************************************************************************/
+template<NodeType nt>
+int AI::search(mySearch &ss, int alpha, int beta, int depthleft, uint16_t excluded)
 {
-	myMove mmove;
-	
-	//Find all the possible next states for current state
-	myStates newStates = nextStates(oldState, playerID());
-	myStates newStatesCopy = newStates;
-	time_t maxTime = timeHave();
-	int maxDepth = 5;
-	
-	//if there is no legal move
-	if(newStates.size() == 0)
+	//the eldest brother of a PV node is on the principal variation, every other move is not
+	const NodeType pvChild = nt == NON_PV ? NON_PV : PV;
+	myState &s = ss.state;
+	size_t ply = ss.undoStack.size();
+	//the line of the node ends here until one of its moves is on it
+	ss.pvLength[ply] = ply;
+	ss.nodes++;
+	checkTime(ss);
+	//a helper thread stops when the main thread has its move or a split point above had a cutoff
+	if(stopped(ss))
 	{
-		printf("No legal move!\n");
-		mmove.toRank = 999;
-		return mmove;
+		return 0;
+	}
+	//the buffers of the plies end here, the quiescence search only evaluates
+	if(depthleft == 0 || ply >= MAX_PLY - 1)
+	{
+		return qsearch<pvChild>(ss, alpha, beta);
 	}
 	
-	int alpha = -100000000;
-	int beta = 100000000;
-	
-	int maxScore = -10000001;
-	int score;
+	//evaluate and drawOrWin score for the AI, the search for the player to move
+	int us = s.sideToMove == playerID() ? 1 : -1;
 	
-	//Time limited ID-DLMM miniMax
-	for(int depth = 1; maxTime > time(NULL) && depth <= maxDepth; depth++) {
-		printf("\ndepth: %d\n", depth);
-		alpha = -10000000;
-		beta = 10000000;
-		maxScore = -10000001;
-		while(!newStatesCopy.empty()) {
-			myState evaState = newStatesCopy.top();
-			score = alphaBetaMin(evaState, alpha, beta, depth - 1);
-			if(score > maxScore || (score == maxScore && rand()%2 == 1)) 
-			{
-				maxScore = score;
-				mmove = evaState.move;
-			}
-			newStatesCopy.pop();
-		}
-		std::map<myMove,int>::iterator it;
-		it = history.find(mmove);
+	//If state s is a draw, before the table: a repeated state has the key of its earlier
+	//occurrence, whose stored score is not a draw
+	int evaS = evaluate(ss);
+	if(nt != ROOT && (evaS == 200 || evaS == -200))
+	{
+		return -200 * us;
+	}
 	
-		if(it != history.end())
-		{
-			history[mmove]++;
-		}
-		else
+	//look the state up in the transposition table, the root needs a move so it is always searched
+	uint16_t hashMove = 0;
+	TTData tte;
+	if(tt.probe(s.key, tte))
+	{
+		hashMove = tte.move;
+		if(nt != ROOT && !excluded && ttCutoff(tte, depthleft, alpha, beta))
 		{
-			history.insert(std::pair<myMove,int>(mmove,1));
+			return tte.score;
 		}
-		newStatesCopy = newStates;
 	}
+	int alphaOrig = alpha;
 	
+	int staticEval = us * evaS;
+	bool checked = inCheck(s, !s.sideToMove);
 	
-	return mmove;
-}
-
-/**********************************************************************************************************/
-int AI::alphaBetaMax( const myState &s, int alpha, int beta, int depthleft ) 
-{
-	std::map<myMove,int>::iterator it;
-	if ( depthleft == 0 ) 
+	//Reverse futility pruning: near the leaves, a state far enough above beta is not expected to
+	//fall below it in the few plies left
+	if(nt == NON_PV && !excluded && !checked && depthleft <= RFP_MAX_DEPTH && staticEval - RFP_MARGIN * depthleft >= beta)
 	{
-		//check if the movement can be found
-		it = history.find(s.move);
-		if(it != history.end())
-		{
-			history[s.move]++;
-		}
-		else
-		{
-			history.insert(std::pair<myMove, int>(s.move,1));
-		}
-		
-		if(!s.isQS)
-		{
-			return QSMin(s, 2, alpha, beta);
-		}
-		else
-		{
-			return evaluate( s );
-		}
+		return staticEval;
 	}
-   
-	myMove returnMove;
-   
-	int evaS = evaluate(s);
-   
-	if( evaS != 200 && evaS != -200)
+	
+	//Razoring: a state far below alpha near the leaves only gets back to it with a capture,
+	//so the quiescence search decides
+	if(nt == NON_PV && !excluded && !checked && depthleft <= RAZOR_MAX_DEPTH && staticEval + RAZOR_MARGIN * depthleft <= alpha)
 	{
-		myStates newStates = nextStates( s, playerID());
-   
-		// set score to -infinite
-		int score = -1000000;
-   
-		// If there is no possible moves
-		if(newStates.empty())
+		int razorScore = qsearch<NON_PV>(ss, alpha, alpha + 1);
+		if(stopped(ss))
 		{
-			score = drawOrWin( s );
-			if(score >= beta)
-			{
-				//check if the movement can be found
-				it = history.find(s.move);
-				if(it != history.end())
-				{
-					history[s.move]++;
-				}
-				else
-				{
-					history.insert(std::pair<myMove,int>(s.move,1));
-				}
-				return score;
-			}
-			if(score > alpha)
-			{
-				alpha = score;
-			}
+			return 0;
+		}
+		if(razorScore <= alpha)
+		{
+			return razorScore;
 		}
-   
-		while(!newStates.empty()) 
+	}
+	
+	//Null-move pruning: when passing the turn still fails high, a move would too. Not in check,
+	//not twice in a row, and not with only pawns left, where passing may be the best move (zugzwang)
+	if(nt == NON_PV && !excluded && !checked && depthleft >= 2 && staticEval >= beta && ply >= ss.nullMinPly
+		&& ss.undoStack.back().moved != NO_PIECE
+		&& (s.occupied[s.sideToMove] & ~(s.pieces[s.sideToMove][PAWN] | s.pieces[s.sideToMove][KING])))
+	{
+		//the deeper and the further above beta, the more the null move is reduced
+		int R = NULL_MOVE_R + depthleft / 4 + std::min(staticEval - beta, 2);
+		int nullDepth = std::max(depthleft - 1 - R, 0);
+		makeNullMove(ss);
+		ss.extended[ply + 1] = ss.extended[ply];
+		int nullScore = -search<NON_PV>(ss, -beta, -beta + 1, nullDepth);
+		unmakeNullMove(ss);
+		if(stopped(ss))
 		{
-			myState state = newStates.top();
-			int tmpScore = alphaBetaMin( state, alpha, beta, depthleft - 1 );
-			if(tmpScore > score) 
+			return 0;
+		}
+		if(nullScore >= beta)
+		{
+			//a mate after passing is not a proved mate
+			if(nullScore >= 1000)
 			{
-				returnMove = state.move;
-				score = tmpScore;
+				nullScore = beta;
 			}
-			if( score >= beta )
+			if(depthleft < NULL_VERIFY_DEPTH || ss.nullMinPly > 0)
 			{
-				//check if the movement can be found
-				it = history.find(state.move);
-				if(it != history.end())
-				{
-					history[state.move]++;
-				}
-				else
-				{
-					history.insert(std::pair<myMove,int>(state.move,1));
-				}
-				return score;   // fail hard beta-cutoff
+				return nullScore;
 			}
-			if( score > alpha )
+			//at a high depth, a search without null moves for the next plies verifies the cutoff
+			ss.nullMinPly = ply + 3 * nullDepth / 4 + 1;
+			int verified = search<NON_PV>(ss, beta - 1, beta, nullDepth);
+			ss.nullMinPly = 0;
+			if(verified >= beta)
 			{
-				alpha = score; // alpha acts like max in MiniMax
+				return nullScore;
 			}
-			newStates.pop();
 		}
-		
-		//check if the movement can be found
-		it = history.find(returnMove);
-		if(it != history.end())
+	}
+	
+	//Singular extension: the transposition table move is searched one ply deeper when every
+	//other move, searched less deep, is clearly worse than its score
+	int singular = 0;
+	if(nt != ROOT && !excluded && hashMove && depthleft >= SINGULAR_MIN_DEPTH && tte.depth >= depthleft - 3
+		&& tte.bound() != BOUND_UPPER && tte.score > -200 && tte.score < 200)
+	{
+		int singularBeta = tte.score - SINGULAR_MARGIN;
+		int singularScore = search<NON_PV>(ss, singularBeta - 1, singularBeta, (depthleft - 1) / 2, hashMove);
+		if(stopped(ss))
 		{
-			history[returnMove]++;
+			return 0;
 		}
-		else
+		if(singularScore < singularBeta)
 		{
-			history.insert(std::pair<myMove,int>(returnMove,1));
+			singular = SINGULAR_EXTENSION;
 		}
-		
-		return score;
 	}
 	
-	else //If state s is a draw
+	//on the principal variation of the last depth, its move is the first without a table move
+	if(nt == PV && !hashMove)
 	{
-		return -200;
+		hashMove = lastPvMove(ss);
 	}
-}
- 
-/**********************************************************************************************************/
-int AI::alphaBetaMin( const myState &s, int alpha, int beta, int depthleft ) 
-{
-	std::map<myMove,int>::iterator it;
-	if ( depthleft == 0 )
+	
+	myMoveScores &rootMoves = ss.moveStack[ply];
+	size_t rootNext = 0;
+	myMovePicker mp;
+	if(nt != ROOT)
+	{
+		initPicker(ss, mp, s.sideToMove, hashMove);
+	}
+	myMove move;
+	myMove returnMove = myMove();
+	int moveCount = 0;
+	
+	// set score to -infinite
+	int score = -1000000;
+	
+	while(nt == ROOT ? pickRootMove(rootMoves, rootNext, move) : pickMove(ss, mp, move))
 	{
-		//check if the movement can be found
-		it = history.find(s.move);
-		if(it != history.end())
+		if(excluded && move.data == excluded)
 		{
-			history[s.move]++;
+			continue;
 		}
-		else
+		moveCount++;
+		//near the leaves some quiet moves are not searched at all, unless every move so far is mated
+		if(nt != ROOT && !checked && moveCount > 1 && score > -1000 && isQuiet(s, move))
 		{
-			history.insert(std::pair<myMove,int>(s.move,1));
+			//Late move pruning: the quiet moves ordered after the first few
+			if(depthleft <= LMP_MAX_DEPTH && moveCount > LMP_MIN_MOVES + depthleft * depthleft)
+			{
+				continue;
+			}
+			//Futility pruning: a quiet move does not win material, so it can not reach alpha
+			//when the static evaluation is too far below it. The margin bounds the score
+			int futilityScore = staticEval + FUTILITY_MARGIN * depthleft;
+			if(depthleft <= FUTILITY_MAX_DEPTH && futilityScore <= alpha)
+			{
+				score = std::max(score, futilityScore);
+				continue;
+			}
 		}
-		
-		if(!s.isQS)
+		int tmpScore;
+		//Young Brothers Wait: once the eldest brother is searched the others can be searched in parallel.
+		//A split point does not know the excluded move of a singular search, so that search never splits
+		if(moveCount == 2 && !excluded && canSplit(ss, depthleft))
 		{
-			return QSMax(s, 2, alpha, beta);
+			tmpScore = nt == ROOT
+				? split(ss, rootMoves, rootNext - 1, depthleft, alpha, beta, true, checked, move)
+				: split(ss, pickRemaining(ss, mp, move), 0, depthleft, alpha, beta, nt != NON_PV, checked, move);
+			//the split point searched every remaining move, the picker of a node was drained by pickRemaining
+			rootNext = rootMoves.size();
+			//the line of the best move may have been searched by another thread
+			ss.pvLength[ply + 1] = ply + 1;
+		}
+		else if(moveCount == 1)
+		{
+			makeMove(ss, move);
+			int newDepth = depthleft - 1 + extension(ss, move.data == hashMove ? singular : 0);
+			tmpScore = -search<pvChild>(ss, -beta, -alpha, newDepth);
+			unmakeMove(ss);
 		}
 		else
 		{
-			return evaluate( s );
+			tmpScore = searchLateMove(ss, move, moveCount, depthleft, alpha, beta, nt != NON_PV, checked);
 		}
-	}
-   
-	myMove returnMove;
-	
-	int evaS = evaluate( s );
-	
-	if(evaS != 200 && evaS != -200) 
-	{
-		myStates newStates = nextStates( s, !playerID());
-   
-		// Set the socre to infinite
-		int score = 10000;
-   
-		// If there is no possible moves
-		if(newStates.empty())
+		if(stopped(ss))
 		{
-			score = drawOrWin( s );
-			if( score <= alpha )
-			{
-				//check if the movement can be found
-				it = history.find(s.move);
-				if(it != history.end())
-				{
-					history[s.move]++;
-				}
-				else
-				{
-					history.insert(std::pair<myMove,int>(s.move,1));
-				}
-				return score;
-			}
-			if( score < beta )
+			return 0;
+		}
+		if(tmpScore > score)
+		{
+			returnMove = move;
+			score = tmpScore;
+			if(nt != NON_PV)
 			{
-				beta = score;
+				updatePv(ss, ply, move);
 			}
 		}
-   
-		while(!newStates.empty()) 
+		if(score >= beta)
 		{
-			myState state = newStates.top();
-			int tmpScore = alphaBetaMax( state, alpha, beta, depthleft - 1 );
-			if(tmpScore < score)
+			historyBonus(ss, move, depthleft);
+			if(isQuiet(s, move))
 			{
-				returnMove = state.move;
-				score = tmpScore;
+				quietCutoff(ss, move);
 			}
-			if( score <= alpha )
+			//the root fails high above an aspiration window with a move better than the last best
+			if(nt == ROOT)
 			{
-				//check if the movement can be found
-				it = history.find(state.move);
-				if(it != history.end())
-				{
-					history[state.move]++;
-				}
-				else
-				{
-					history.insert(std::pair<myMove,int>(state.move,1));
-				}
-				return score; // fail hard alpha-cutoff
+				ss.rootMove = move;
 			}
-			if( score < beta )
+			if(!excluded)
 			{
-				beta = score; // beta acts like min in MiniMax
+				tt.store(s.key, score, BOUND_LOWER, depthleft, move.data);
 			}
-			newStates.pop();
+			return score;
 		}
-		
-		//check if the movement can be found
-		it = history.find(returnMove);
-		if(it != history.end())
+		if(score > alpha)
 		{
-			history[returnMove]++;
+			alpha = score;
 		}
-		else
+	}
+	
+	//with the excluded move as the only move, it is singular
+	if(moveCount == 0 && excluded)
+	{
+		return alpha;
+	}
+	// If there is no possible moves
+	if(moveCount == 0)
+	{
+		score = us * drawOrWin(s);
+		if(score >= beta)
 		{
-			history.insert(std::pair<myMove,int>(returnMove,1));
+			return score;
 		}
-		return score;
 	}
 	
-	else //If state s is a draw
+	if(nt == ROOT)
+	{
+		ss.rootMove = returnMove;
+	}
+	if(!excluded)
 	{
-		return -200;
+		tt.store(s.key, score, score > alphaOrig ? BOUND_EXACT : BOUND_UPPER, depthleft, returnMove.data);
 	}
+	return score;
 }
+
 /************************************************************************************************************/
-int AI::QSMax(const myState &s, int depth, int alpha, int beta)
+template<NodeType nt>
+int AI::qsearch(mySearch &ss, int alpha, int beta)
 {
-	std::map<myMove,int>::iterator it;
-	//If it is a quite state or depth limited reached
-	if(s.isQS || depth == 0)
+	myState &s = ss.state;
+	//the principal variation ends with the quiet state
+	ss.pvLength[ss.undoStack.size()] = ss.undoStack.size();
+	ss.nodes++;
+	checkTime(ss);
+	//a helper thread stops when the main thread has its move or a split point above had a cutoff
+	if(stopped(ss))
+	{
+		return 0;
+	}
+	
+	//evaluate and drawOrWin score for the AI, the search for the player to move
+	int us = s.sideToMove == playerID() ? 1 : -1;
+	int evaS = evaluate(ss);
+	//If state s is a draw
+	if(evaS == 200 || evaS == -200)
+	{
+		return -200 * us;
+	}
+	evaS *= us;
+	//the buffers of the plies end here
+	if(ss.undoStack.size() >= MAX_PLY - 1)
+	{
+		return evaS;
+	}
+	
+	//look the state up in the transposition table
+	uint16_t hashMove = 0;
+	TTData tte;
+	if(tt.probe(s.key, tte))
 	{
-		it = history.find(s.move);
-		if(it != history.end())
+		hashMove = tte.move;
+		if(ttCutoff(tte, 0, alpha, beta))
 		{
-			history[s.move]++;
+			return tte.score;
 		}
-		else
+	}
+	int alphaOrig = alpha;
+	myMove returnMove = myMove();
+	
+	//in check every move is searched, the player can not stand pat
+	bool checked = inCheck(s, !s.sideToMove);
+	//the player does not have to capture, so the static evaluation is a lower bound
+	int score = -1000000;
+	if(!checked)
+	{
+		score = evaS;
+		if(score >= beta)
+		{
+			return score;
+		}
+		if(score > alpha)
 		{
-			history.insert(std::pair<myMove,int>(s.move,1));
+			alpha = score;
 		}
-		return evaluate(s);
 	}
-	else
-	{
 	
-		myMove returnMove;
-	   
-		int evaS = evaluate(s);
-	   if( evaS != 200 && evaS != -200)
-	   {
-			myStates newStates = nextStates( s, playerID());
-	   
-			// set score to -infinite
-			int score = -1000000;
-	   
-			// If there is no possible moves
-			if(newStates.empty())
-			{
-				score = drawOrWin( s );
-				if(score >= beta)
-				{
-					//check if the movement can be found
-					it = history.find(s.move);
-					if(it != history.end())
-					{
-						history[s.move]++;
-					}
-					else
-					{
-						history.insert(std::pair<myMove,int>(s.move,1));
-					}
-					return score;
-				}
-				if(score > alpha)
-				{
-					alpha = score;
-				}
-			}
-	   
-			while(!newStates.empty()) 
-			{
-				myState state = newStates.top();
-				//do QS search
-				int tmpScore = QSMin( state, depth -1 , alpha, beta );
-				if(tmpScore > score) 
-				{
-					returnMove = state.move;
-					score = tmpScore;
-				}
-				if( score >= beta )
-				{
-					//check if the movement can be found
-					it = history.find(state.move);
-					if(it != history.end())
-					{
-						history[state.move]++;
-					}
-					else
-					{
-						history.insert(std::pair<myMove,int>(state.move,1));
-					}
-					return score;   // fail hard beta-cutoff
-				}
-				if( score > alpha )
-				{
-					alpha = score; // alpha acts like max in MiniMax
-				}
-				newStates.pop();
-			}
-			
-			//check if the movement can be found
-			it = history.find(returnMove);
-			if(it != history.end())
-			{
-				history[returnMove]++;
-			}
-			else
-			{
-				history.insert(std::pair<myMove,int>(returnMove,1));
-			}
-			
+	myMovePicker mp;
+	initPicker(ss, mp, s.sideToMove, hashMove, !checked);
+	myMove move;
+	int moveCount = 0;
+	while(pickMove(ss, mp, move))
+	{
+		moveCount++;
+		//delta pruning, even winning the piece and a margin does not reach alpha
+		if(!checked && move.type() != PROMOTION
+			&& evaS + PieceValue[capturedAt(s, move)] + DELTA_MARGIN <= alpha)
+		{
+			continue;
+		}
+		makeMove(ss, move);
+		int tmpScore = nt == PV && moveCount == 1 ? -qsearch<PV>(ss, -beta, -alpha) : -qsearch<NON_PV>(ss, -beta, -alpha);
+		unmakeMove(ss);
+		if(stopped(ss))
+		{
+			return 0;
+		}
+		if(tmpScore > score)
+		{
+			returnMove = move;
+			score = tmpScore;
+		}
+		if(score >= beta)
+		{
+			tt.store(s.key, score, BOUND_LOWER, 0, move.data);
 			return score;
 		}
-		
-		else //If state s is a draw
+		if(score > alpha)
 		{
-			return -200;
+			alpha = score;
 		}
 	}
-}
 	
+	//checkmate or stalemate
+	if(checked && moveCount == 0)
+	{
+		return us * drawOrWin(s);
+	}
+	
+	tt.store(s.key, score, score > alphaOrig ? BOUND_EXACT : BOUND_UPPER, 0, returnMove.data);
+	return score;
+}
 
 /************************************************************************************************************/
-int AI::QSMin(const myState &s, int depth, int alpha, int beta)
+bool AI::isRepetition(const mySearch &ss)
 {
-	std::map<myMove,int>::iterator it;
-	//If it is a quite state or depth limited reached
-	if(s.isQS || depth == 0)
+	const myState &s = ss.state;
+	size_t searchPlies = ss.undoStack.size() - ss.rootPly;
+	
+	//the undo stack keeps the key before each move of the search, the game keys the ones before the root
+	for(int back = 1; back <= s.turnsWithNoPorC; back++)
 	{
-		it = history.find(s.move);
-		if(it != history.end())
+		Key key;
+		if(size_t(back) <= searchPlies)
+		{
+			const myUndo &u = ss.undoStack[ss.undoStack.size() - back];
+			if(u.moved == NO_PIECE)
+			{
+				return false;
+			}
+			key = u.key;
+		}
+		else if(size_t(back) - searchPlies <= gameKeys.size())
 		{
-			history[s.move]++;
+			key = gameKeys[gameKeys.size() - (back - searchPlies)];
 		}
 		else
 		{
-			history.insert(std::pair<myMove,int>(s.move,1));
+			return false;
 		}
-		return evaluate(s);
-	}
-	//If it is not a quite state, do the QSMax search
-	else
-	{
-		myMove returnMove;
-		
-		int evaS = evaluate(s);
-		if(evaS != 200 && evaS != -200) 
-		{
-			myStates newStates = nextStates( s, !playerID());
-   
-			// Set the socre to infinite
-			int score = 10000;
-   
-			// If there is no possible moves
-			if(newStates.empty())
-			{
-				score = drawOrWin( s );
-				if( score <= alpha )
-				{
-					//check if the movement can be found
-					it = history.find(s.move);
-					if(it != history.end())
-					{
-						history[s.move]++;
-					}
-					else
-					{
-					history.insert(std::pair<myMove,int>(s.move,1));
-					}
-					return score;
-				}
-				if( score < beta )
-				{
-					beta = score;
-				}
-			}
-   
-			while(!newStates.empty()) 
-			{
-				myState state = newStates.top();
-				//do QS
-				int tmpScore = QSMax( state, depth-1, alpha, beta );
-				if(tmpScore < score)
-				{
-					returnMove = state.move;
-					score = tmpScore;
-				}
-				if( score <= alpha )
-				{
-					//check if the movement can be found
-					it = history.find(state.move);
-					if(it != history.end())
-					{
-						history[state.move]++;
-					}
-					else
-					{
-						history.insert(std::pair<myMove,int>(state.move,1));
-					}
-					return score; // fail hard alpha-cutoff
-				}
-				if( score < beta )
-				{
-					beta = score; // beta acts like min in MiniMax
-				}
-				newStates.pop();
-			}
 		
-			//check if the movement can be found
-			it = history.find(returnMove);
-			if(it != history.end())
-			{
-				history[returnMove]++;
-			}
-			else
-			{
-				history.insert(std::pair<myMove,int>(returnMove,1));
-			}
-			return score;
-		}
-	
-		else //If state s is a draw
+		//only the same player can be to move in the same position
+		if(back % 2 == 0 && key == s.key)
 		{
-			return -200;
+			return true;
 		}
 	}
+	return false;
 }
-		
 
 /************************************************************************************************************/
-int AI::evaluate(const myState &s)
+int AI::evaluate(const mySearch &ss)
 {
+	const myState &s = ss.state;
 	//evaluate the state
 	int player0 = 0;
 	int player1 = 0;
 	
-	bool whiteLose = true;
-	bool blackLose = true;
-	bool impossibleToCheckmate = true;
-	
-	//pieceSet is used to store potential draw pieces that cause impossible to checkmate
-	std::set<char> pieceSet;
-	std::set<char>::iterator itrl, itrU;
-	
-	// rank and file for white and black bishops, only for impposible to checkmate situation
-	int wbr = 0;
-	int wbf = 0;
-	int bbr = 0;
-	int bbf = 0;
-	
-	for(int rank = 0; rank < 8; rank++)
+	//material, pawn = 1, knight = 3, bishop = 3, rook = 5, queen = 9
+	for(int type = PAWN; type < KING; type++)
 	{
-		for(int file = 0; file < 8; file++)
-		{
-			//pawn
-			if(s.board[rank][file] == 'P')
-			{
-				player0++;
-				impossibleToCheckmate = false;
-			}
-			else if(s.board[rank][file] == 'p')
-			{
-				player1++;
-				impossibleToCheckmate = false;
-			}
-			
-			//knight
-			else if(s.board[rank][file] == 'N')
-			{
-				player0+=3;
-				itrU = pieceSet.find('N');
-				itrl = pieceSet.find('n');
-				//avoid two knights
-				if(itrU != pieceSet.end() && itrl != pieceSet.end())
-				{
-					impossibleToCheckmate = false;
-				}
-				else if(impossibleToCheckmate)
-				{
-					pieceSet.insert('N');
-				}
-			}
-			else if(s.board[rank][file] == 'n')
-			{
-				player1+=3;
-				itrl = pieceSet.find('n');
-				itrU = pieceSet.find('N');
-				//Avoid two knights
-				if(itrl != pieceSet.end() && itrU != pieceSet.end())
-				{
-					impossibleToCheckmate = false;
-				}
-				else if(impossibleToCheckmate)
-				{
-					pieceSet.insert('n');
-				}
-			}
-			
-			//bishop
-			else if(s.board[rank][file] == 'B')
-			{
-				player0+=3;
-				itrU = pieceSet.find('B');
-				//avoid two bishops from white
-				if(itrU != pieceSet.end())
-				{
-					impossibleToCheckmate = false;
-				}
-				else if(impossibleToCheckmate)
-				{
-					pieceSet.insert('B');
-					wbr = rank;
-					wbf = file;
-				}
-			}
-			else if(s.board[rank][file] == 'b')
-			{
-				player1+=3;
-				itrl = pieceSet.find('b');
-				//avoid two bishops from black
-				if(itrl != pieceSet.end())
-				{
-					impossibleToCheckmate = false;
-				}
-				else if(impossibleToCheckmate)
-				{
-					pieceSet.insert('b');
-					bbr = rank;
-					bbf = file;
-				}
-			}
-			
-			//rook
-			else if(s.board[rank][file] == 'R')
-			{
-				player0+=5;
-				impossibleToCheckmate = false;
-			}
-			else if(s.board[rank][file] == 'r')
-			{
-				player1+=5;
-				impossibleToCheckmate = false;
-			}
-			
-			//queen
-			else if(s.board[rank][file] == 'Q')
-			{
-				player0+=9;
-				impossibleToCheckmate = false;
-			}
-			else if(s.board[rank][file] == 'q')
-			{
-				player1+=9;
-				impossibleToCheckmate = false;
-			}
-			
-			//king
-			else if(s.board[rank][file] == 'K')
-			{
-				whiteLose = false;
-			}
-			else if(s.board[rank][file] == 'k')
-			{
-				blackLose = false;
-			}
-		}
+		player0 += PieceValue[type] * popCount(s.pieces[0][type]);
+		player1 += PieceValue[type] * popCount(s.pieces[1][type]);
 	}
 	
+	bool whiteLose = !s.pieces[0][KING];
+	bool blackLose = !s.pieces[1][KING];
 	
-	//check if it is impossible to check mate
-	if(!whiteLose && !blackLose && !impossibleToCheckmate)
+	//check if it is impossible to check mate, only kings and at most one minor piece each
+	bool impossibleToCheckmate = false;
+	Bitboard heavy = s.pieces[0][PAWN] | s.pieces[1][PAWN] | s.pieces[0][ROOK] | s.pieces[1][ROOK]
+		| s.pieces[0][QUEEN] | s.pieces[1][QUEEN];
+	if(!whiteLose && !blackLose && !heavy)
 	{
-		// King vs King
-		if(pieceSet.size() == 0)
+		Bitboard knights = s.pieces[0][KNIGHT] | s.pieces[1][KNIGHT];
+		Bitboard bishops = s.pieces[0][BISHOP] | s.pieces[1][BISHOP];
+		int minors = popCount(knights | bishops);
+		
+		// King vs King, or King and one minor piece vs King
+		if(minors <= 1)
 		{
 			impossibleToCheckmate = true;
 		}
-		else
+		// Only one Bishop each, on the same color of square
+		else if(!knights && popCount(s.pieces[0][BISHOP]) == 1 && popCount(s.pieces[1][BISHOP]) == 1)
 		{
-			std::set<char>::iterator Nit, nit, Bit, bit;
-			Nit = pieceSet.find('N');
-			nit = pieceSet.find('n');
-			Bit = pieceSet.find('B');
-			bit = pieceSet.find('b');
-			
-			// There are Knight and Bishops
-			if((Nit != pieceSet.end() || nit != pieceSet.end()) && ( Bit != pieceSet.end() || bit != pieceSet.end())) 
-			{
-				impossibleToCheckmate = false;
-			}
-			//Only Knight
-			else if((Nit != pieceSet.end() || nit != pieceSet.end()) &&  Bit == pieceSet.end() && bit == pieceSet.end())
-			{
-				impossibleToCheckmate = true;
-			}
-			//Only Bishop
-			else if( Nit == pieceSet.end() && nit == pieceSet.end())
-			{
-				//	Two Bishops
-				if(Bit != pieceSet.end() && bit != pieceSet.end())
-				{
-					int absR = abs(wbr - bbr);
-					int absF = abs(wbf - bbf);
-					if((absR%2) != (absF%2))
-					{
-						impossibleToCheckmate = false;
-					}
-					else
-					{
-						impossibleToCheckmate = true;
-					}
-				}
-				// One Bishop
-				else if(Bit != pieceSet.end() || bit != pieceSet.end())
-				{
-					impossibleToCheckmate = true;
-				}
-				else
-				{
-					impossibleToCheckmate = false;
-				}
-			}
-			else
-			{
-				impossibleToCheckmate = false;
-			}
+			impossibleToCheckmate = !(bishops & LightSquares) || !(bishops & ~LightSquares);
 		}
 	}
 	
 	//check for state repetition
-	bool stateRep = true;
-	//check for no capture or pawn advancement
-	if(s.turnsLeft > 0)
-	{
-		stateRep = false;
-	}
-	else if(s.lastMoves.size() >= 8)
-	{
-		size_t i;
-		for(i=0; i< 4; i++)
-		{
-			if((s.lastMoves[i].fromRank != s.lastMoves[i+4].fromRank) 
-				|| (s.lastMoves[i].fromFile != s.lastMoves[i+4].fromFile))
-			{
-				stateRep = false;
-				break;
-			}
-		}
-	}
-	else if(s.lastMoves.size() < 8)
-	{
-		stateRep = false;
-	}
+	bool stateRep = isRepetition(ss);
 	
 	//win or lose
 	if(whiteLose)
@@ -1680,7 +2319,7 @@ int AI::evaluate(const myState &s)
 	}
 	
 	//draw
-	if(impossibleToCheckmate || stateRep || s.turnsWithNoPorC == 100)
+	if(impossibleToCheckmate || stateRep || s.turnsWithNoPorC >= 100)
 	{
 		if(playerID())
 		{
@@ -1713,23 +2352,15 @@ int AI::drawOrWin(const myState &s)
 	int score = -200;
 	
 	//checkmate in white's favor
-	myMoves possibleMoves = legalMoves(s, playerID());
-	for(int i = 0; i < possibleMoves.size(); i++)
+	if(inCheck(s, 0))
 	{
-		if(s.board[possibleMoves[i].toRank][possibleMoves[i].toFile] == 'k')
-		{
-			score = 1000;
-		}
+		score = 1000;
 	}
 	
 	//checkmate in black's favor
-	possibleMoves = legalMoves(s, !playerID());
-	for(int i = 0; i < possibleMoves.size(); i++)
+	if(inCheck(s, 1))
 	{
-		if(s.board[possibleMoves[i].toRank][possibleMoves[i].toFile] == 'K')
-		{
-			score = -1000;
-		}
+		score = -1000;
 	}
 	
 	//reverse score if player1
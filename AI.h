@@ -2,66 +2,288 @@
 #define AI_H
 
 #include "BaseAI.h"
+#include "bitboard.h"
+#include "zobrist.h"
+#include "tt.h"
 #include <iostream>
 #include <cstdlib>
 #include <time.h>
-#include <queue>
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 using namespace std;
 
+///Number of threads searching each move, set it with -DSEARCH_THREADS=<n> in the Makefile
+#ifndef SEARCH_THREADS
+#define SEARCH_THREADS 1
+#endif
+
+///How the threads share the work of a search
+enum SearchBackend
+{
+	///Every thread searches the whole tree, they only share the transposition table
+	LAZY_SMP,
+	///Young Brothers Wait: the moves of a node are split between the threads once its first move is searched
+	YBW
+};
+
+///The backend used by the threads, set it with -DSEARCH_BACKEND=YBW in the Makefile
+#ifndef SEARCH_BACKEND
+#define SEARCH_BACKEND LAZY_SMP
+#endif
+
+///The bound of the history scores, a bonus moves a score this far from it
+const int HISTORY_MAX = 16384;
+
+///A capture in the quiescence search is not searched when the material it wins plus
+///this margin (in pawns) can not bring the score back to the window (delta pruning)
+const int DELTA_MARGIN = 2;
+
+///The ordering score of a counter-move, the killers come just above it and every history score below
+const int KILLER_SCORE = 2 * HISTORY_MAX;
+///Added to the history score of the captures and promotions, so they come before the killers
+const int CAPTURE_SCORE = 2 * KILLER_SCORE;
+
+///The largest depth left for which a node whose static evaluation is this margin (in pawns)
+///per ply above beta fails high without a search (reverse futility pruning)
+const int RFP_MAX_DEPTH = 3;
+const int RFP_MARGIN = 1;
+///The largest depth left for which the quiet moves are not searched when the static evaluation
+///plus this margin (in pawns) per ply can not reach alpha (futility pruning)
+const int FUTILITY_MAX_DEPTH = 3;
+const int FUTILITY_MARGIN = 1;
+///The largest depth left for which a node whose static evaluation is this margin (in pawns)
+///per ply below alpha is searched with the quiescence search first, and fails low when it
+///stays below alpha there (razoring)
+const int RAZOR_MAX_DEPTH = 2;
+const int RAZOR_MARGIN = 2;
+
+///The smallest reduction of the null move, the depth left and the static evaluation above
+///beta add to it
+const int NULL_MOVE_R = 2;
+///The smallest depth left for which a null-move cutoff is verified by a search without null
+///moves, set it above any depth searched to turn the verification off
+const int NULL_VERIFY_DEPTH = 10;
+
+///The smallest depth left for which the late quiet moves are searched with a reduced depth
+const int LMR_MIN_DEPTH = 3;
+///The number of moves of a node always searched at full depth, one more at a PV node
+const int LMR_FULL_MOVES = 2;
+///The largest depth left for which the late quiet moves are not searched at all
+const int LMP_MAX_DEPTH = 3;
+///The number of moves of a node searched before late move pruning, the square of the depth
+///left adds to it
+const int LMP_MIN_MOVES = 3;
+
+///The extensions are counted in fractions of a ply, a line is searched one ply deeper for
+///every ONE_PLY of them, so the small extensions add up along the line
+const int ONE_PLY = 4;
+///The extension of a move that gives check
+const int CHECK_EXTENSION = 4;
+///The extension of a capture on the square of the capture just before it
+const int RECAPTURE_EXTENSION = 2;
+///The extension of a pawn move to the 7th rank
+const int PAWN_PUSH_EXTENSION = 4;
+///The extension of the transposition table move when every other move is worse (singular)
+const int SINGULAR_EXTENSION = 4;
+///The smallest depth left for which the transposition table move is tested for a singular extension
+const int SINGULAR_MIN_DEPTH = 6;
+///How far (in pawns) below the score of the transposition table move every other move has
+///to be for it to be singular
+const int SINGULAR_MARGIN = 1;
+///The most plies a line is extended by, so checks and recaptures can not make it explode
+const int EXTENSION_BUDGET = 8;
+
+///The half width (in pawns) of the first aspiration window around the score of the last
+///depth, it doubles every time the score falls outside
+const int ASPIRATION_WINDOW = 1;
+
+///The smallest depth left for which a node is split between the threads
+const int YBW_MIN_DEPTH = 3;
+///The most split points one thread owns at the same time
+const int YBW_MAX_SPLITS = 8;
+
+///The most moves of a state, no chess position has more than 218
+const int MAX_MOVES = 256;
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @class myList
+/// @brief This class is a list with a fixed capacity N, its items are kept in the
+/// list itself so it never allocates memory. Adding more than N items is an error
+////////////////////////////////////////////////////////////////////////////////////
+
+template<class T, int N>
+class myList
+{
+	public:
+		myList() : count(0) {}
+		myList(const myList &other) { *this = other; }
+		
+		//only the items in the list are copied
+		myList &operator=(const myList &other)
+		{
+			count = other.count;
+			std::copy(other.items, other.items + count, items);
+			return *this;
+		}
+		
+		void push_back(const T &item) { items[count++] = item; }
+		void pop_back() { count--; }
+		void clear() { count = 0; }
+		//when the list grows, the new items are whatever was left there
+		void resize(size_t size) { count = size; }
+		
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		
+		T &operator[](size_t i) { return items[i]; }
+		const T &operator[](size_t i) const { return items[i]; }
+		T &back() { return items[count - 1]; }
+		const T &back() const { return items[count - 1]; }
+		T *begin() { return items; }
+		T *end() { return items + count; }
+		const T *begin() const { return items; }
+		const T *end() const { return items + count; }
+		
+	private:
+		T items[N];
+		size_t count;
+};
+
+///The kinds of move, kept in the top two bits of myMove::data
+enum MoveType
+{
+	NORMAL = 0,
+	PROMOTION = 1 << 14,
+	EN_PASSANT = 2 << 14,
+	CASTLING = 3 << 14
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////
 /// @struct myMove
-/// @brief This struct stores the information of a move
+/// @brief This struct stores a move in 16 bits: the from square in bits 0-5, the
+/// to square in bits 6-11, the promotion piece type minus KNIGHT in bits 12-13 and
+/// the MoveType in bits 14-15. The squares are the ones of bitboard.h, the server's
+/// files and ranks from 1 are only used in AI::run. The player is the one to move
+/// in the state the move is made in. No move is 0, a8 to a8
 ////////////////////////////////////////////////////////////////////////////////////////
 
 struct myMove
 {
-	///The initial file location
-	int fromFile;
-	///The initial rank location
-	int fromRank;
-	///The final file location
-	int toFile;
-	///The final rank location
-	int toRank;
-	///The type of the piece for pawn promotion. Q=Queen, B=Bishop, N=Knight, R=Rook
-	int promoteType;
-	/// The player of the move
-	int player;
+	///The packed move, it is also what the transposition table keeps
+	uint16_t data;
+	
+	myMove() = default;
+	explicit myMove(uint16_t packed) : data(packed) {}
+	
+	///The move from 'from' to 'to', promote is the piece type of a PROMOTION
+	static myMove make(int from, int to, MoveType type = NORMAL, int promote = KNIGHT)
+	{
+		return myMove(uint16_t(from | to << 6 | (promote - KNIGHT) << 12 | type));
+	}
+	
+	int from() const { return data & 63; }
+	int to() const { return (data >> 6) & 63; }
+	int fromFile() const { return fileOf(from()); }
+	int fromRank() const { return rankOf(from()); }
+	int toFile() const { return fileOf(to()); }
+	int toRank() const { return rankOf(to()); }
+	MoveType type() const { return MoveType(data & (3 << 14)); }
+	///The piece type a pawn promotes to, only for a PROMOTION
+	int promoteType() const { return KNIGHT + ((data >> 12) & 3); }
+	
+	bool operator==(const myMove &other) const { return data == other.data; }
+	bool operator!=(const myMove &other) const { return data != other.data; }
 };
-typedef std::vector<myMove> myMoves;
+static_assert(sizeof(myMove) == 2, "myMove is 16 bits");
+typedef myList<myMove, MAX_MOVES> myMoves;
+
+///The castling rights in myState::castling
+enum { WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8 };
+
+///The deepest ply the search can reach, including the game move kept in the undo stack
+const int MAX_PLY = 128;
+
+///The most game positions kept for the repetitions, more than the 100 plies of the fifty-move rule
+const int MAX_GAME_KEYS = 128;
+
+///The value of each piece type in pawns, the king's is only used by AI::see
+const int PieceValue[6] = {1, 3, 3, 5, 9, 100};
 
 /////////////////////////////////////////////////////////////////////////////////////
 /// @struct myState
-/// @brief This struct stores the board information of a state and the previous move
+/// @brief This struct stores the board information of a state. The moves that led
+/// to it are kept in AI's undo stack. It is plain data in two cache lines, so the
+/// split points and the searches copy it with a memcpy
 ////////////////////////////////////////////////////////////////////////////////////
 
 struct myState
 {
-	///The board states
-	char board[8][8];
-	///If the piece has moved
-	bool hasMoved[8][8];
-	///Turns left for draws
-	int turnsLeft;
+	///The squares of each piece type for each player, indexed [player][PieceType]
+	Bitboard pieces[2][6];
+	///The squares of all the pieces of each player
+	Bitboard occupied[2];
+	///The Zobrist key of the state, kept up to date by AI::makeMove
+	Key key;
+	///The square a pawn can move to when capturing en passant, NO_SQUARE if none
+	int8_t epSquare;
+	///The castling rights left, WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO
+	uint8_t castling;
 	///Turns to draw because of no pawn advancement or capture
+	uint16_t turnsWithNoPorC;
+	///The player to move
+	uint8_t sideToMove;
+};
+static_assert(std::is_trivially_copyable<myState>::value, "myState is copied as plain data");
+static_assert(sizeof(myState) <= 128, "myState fits in two cache lines");
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct myUndo
+/// @brief This struct stores a move made with AI::makeMove and what is needed to
+/// take it back
+////////////////////////////////////////////////////////////////////////////////////
+
+struct myUndo
+{
+	///The action
+	myMove move;
+	///The type of the piece that moved
+	int moved;
+	///The type of the piece captured, NO_PIECE if none
+	int captured;
+	///myState::epSquare before the move
+	int epSquare;
+	///myState::castling before the move
+	int castling;
+	///myState::turnsWithNoPorC before the move
 	int turnsWithNoPorC;
-	///last seven moves
-	myMoves lastMoves;
+	///myState::key before the move
+	Key key;
+};
+typedef myList<myUndo, MAX_PLY> myUndos;
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct myMoveScore
+/// @brief This struct stores a move and its score for move ordering
+////////////////////////////////////////////////////////////////////////////////////
+
+struct myMoveScore
+{
 	///The action
 	myMove move;
 	///The score in History Table
 	int histScore;
-	///If this state is a quite state
-	int isQS;
 };
+typedef myList<myMoveScore, MAX_MOVES> myMoveScores;
 
-class state_comp
+class score_comp
 {
 	public:
-		bool operator() (myState & lhs, myState & rhs)
+		bool operator() (const myMoveScore & lhs, const myMoveScore & rhs) const
 		{
-			//so it makes the priority queue top be the largest
+			//so it sorts the largest score first
 			if(lhs.histScore > rhs.histScore)
 				return true;
 			else
@@ -69,60 +291,339 @@ class state_comp
 		}
 };
 
-class move_comp
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct myCheckInfo
+/// @brief This struct stores the checks and the pins of the king of the player to
+/// move. It is found once for a node, so the generator only gives legal moves
+////////////////////////////////////////////////////////////////////////////////////
+
+struct myCheckInfo
 {
-	public:
-		bool operator() (const myMove & lhs, const myMove & rhs)
-		{
-			//so it makes the priority queue top be the largest
-			if(lhs.toFile > rhs.toFile)
-				return true;
-			else
-				return false;
-		}
+	///The square of the king, NO_SQUARE if the player has no king
+	int kingSquare;
+	///The pieces of the opponent that check the king
+	Bitboard checkers;
+	///The pieces of the player that can only move along the line to their king
+	Bitboard pinned;
+	///The squares the other pieces than the king can move to: every square when the king
+	///is not in check, the checker and the squares between it and the king in a single
+	///check, no square in a double check
+	Bitboard checkMask;
+};
+
+///The moves a generator adds
+enum GenType
+{
+	///every move
+	GEN_ALL,
+	///the captures (en passant too) and the promotions
+	GEN_CAPTURES,
+	///the other moves, castling too
+	GEN_QUIETS
+};
+
+///The stages of myMovePicker, in the order the moves are picked
+enum PickStage
+{
+	PICK_HASH,
+	PICK_GEN_CAPTURES,
+	PICK_CAPTURES,
+	PICK_REFUTATIONS,
+	PICK_BAD_CAPTURES,
+	PICK_GEN_QUIETS,
+	PICK_QUIETS,
+	PICK_DONE
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct myMovePicker
+/// @brief This struct stores where AI::pickMove is in the moves of a node. The
+/// moves of a stage are only generated when the moves before them did not cause a
+/// cutoff, in the buffers of the ply of the node
+////////////////////////////////////////////////////////////////////////////////////
+
+struct myMovePicker
+{
+	///The player to move
+	int player;
+	///The ply of the node, the index of its buffers
+	size_t ply;
+	///The current stage
+	int stage;
+	///The best move from the transposition table (packed), 0 if none
+	uint16_t hashMove;
+	///The two killers of the ply and the counter-move of the last move
+	myMove refutations[3];
+	///The next move of the stage to look at
+	size_t current;
+	///The captures that lose material are kept before this index, to be picked last
+	size_t badCaptures;
+	///If only the captures and promotions that do not lose material are picked (quiescence)
+	bool quiescence;
+	///The checks and pins of the node
+	myCheckInfo ci;
 };
 
-typedef std::priority_queue<myState, std::vector<myState>, state_comp> myStates;
+///The kinds of node of the search
+enum NodeType
+{
+	///the root state, its moves come from the root move list instead of a move picker
+	ROOT,
+	///a node on the principal variation: the root, or the eldest brother of a PV node
+	PV,
+	///every other node
+	NON_PV
+};
+
+struct mySplitPoint;
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct mySearch
+/// @brief This struct stores what one search thread changes while it searches. The
+/// threads only write to the same memory in the transposition table and, with YBW,
+/// in the split points they share
+////////////////////////////////////////////////////////////////////////////////////
+
+struct mySearch
+{
+	///The state being searched, the root state with the moves of undoStack played on it
+	myState state;
+	///history table [player][from][to], raised for the moves that cause a cutoff
+	int history[2][64][64];
+	///two quiet moves that caused a cutoff at each ply, the newest first
+	myMove killers[MAX_PLY][2];
+	///the quiet move that last caused a cutoff after a move, [player][piece][to] of that move
+	myMove counterMoves[2][6][64];
+	///the moves played to reach the state being searched, starting with the last game move
+	myUndos undoStack;
+	///buffers for the moves of each ply, indexed by undoStack.size(). At the root ply
+	///moveStack keeps the root moves, in the order they are searched
+	myMoves genStack[MAX_PLY];
+	myMoveScores moveStack[MAX_PLY];
+	///buffers for the moves of a node given to the other threads, indexed the same way
+	myMoveScores splitStack[MAX_PLY];
+	///the extensions (in fractions of a ply) of the line to each ply, indexed the same way
+	int extended[MAX_PLY];
+	///the principal variation of each ply as packed moves, indexed the same way. The line of a
+	///ply p is pv[p][p] to pv[p][pvLength[p] - 1], so each ply only uses its part of the table
+	uint16_t pv[MAX_PLY][MAX_PLY];
+	int pvLength[MAX_PLY];
+	///the principal variation of the last depth from the root, tried first on the PV nodes along it
+	myList<uint16_t, MAX_PLY> lastPv;
+	///the ply of the root, the number of game moves in the undo stack
+	size_t rootPly;
+	///The best move of the root found by the last search
+	myMove rootMove;
+	///The null move is not tried before this ply, while a null-move cutoff is verified
+	size_t nullMinPly;
+	///The number of states searched
+	long nodes;
+	///The thread number, 0 for the thread that reports the move
+	int id;
+	///The split point whose moves the thread is searching, NULL if there is none
+	mySplitPoint *splitPoint;
+	///The split points of this thread that other threads can join, oldest first
+	myList<mySplitPoint*, YBW_MAX_SPLITS> splitPoints;
+	
+	mySearch();
+};
 
+/////////////////////////////////////////////////////////////////////////////////////
+/// @struct mySplitPoint
+/// @brief This struct stores a node whose younger brothers are searched by several
+/// threads. It lives on the stack of the thread that owns the node, which waits
+/// until every other thread is done with it. The moves, the window and the score
+/// are only used with its own lock held, so the threads searching one split point
+/// do not wait on the others
+////////////////////////////////////////////////////////////////////////////////////
 
+struct mySplitPoint
+{
+	///The split point the owner was searching when it split, NULL at the root
+	mySplitPoint *parent;
+	///The state of the node and the moves played to reach it
+	myState state;
+	myUndos undoStack;
+	///The moves of the node, in the owner's buffer for the ply of the node
+	const myMoveScores *moves;
+	///Guards next, alpha, beta, score and bestMove
+	std::mutex lock;
+	///The index of the next move no thread is searching yet
+	size_t next;
+	///The depth left at the node
+	int depthleft;
+	///If the node is a PV node, its moves that beat alpha are searched again with the full window
+	bool pvNode;
+	///If the player to move is in check at the node, its moves are then not reduced
+	bool checked;
+	///The index of the second move of the node, to count the moves for the reductions
+	size_t first;
+	///The extensions of the line to the node, mySearch::extended at its ply
+	int extended;
+	///The window of the node for the player to move, narrowed as the moves are searched
+	int alpha;
+	int beta;
+	///The best score of the moves searched and its move
+	int score;
+	myMove bestMove;
+	///The number of threads searching the moves of the node, only raised with AI::splitLock held
+	std::atomic<int> workers;
+	///Set when a move fails high, the threads searching the other moves then stop
+	std::atomic<bool> cutoff;
+	///Set while some moves were not given to a thread and there was no cutoff, counted in AI::openSplits
+	std::atomic<bool> open;
+};
 
 ///The class implementing gameplay logic.
 
 ////////////////////////////////////////////////////////////////////////////////////
 /// @fn myMove AI::nextMove(const myState)
 /// @brief This function determines the next legal move of current state based on
-/// random search
+/// random search. With Lazy SMP the helper threads search the same state at the
+/// same time and share what they find through the transposition table, with YBW
+/// they wait to be given the younger brothers of the nodes of the main thread. The
+/// move of the main thread is returned
 /// @param &oldState is the current state of the board
 /// @return Next legal move based on random search
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn myState AI::newState(myState, const myMove &m)
-/// @brief This function determine the next state after the legal move
+/// @fn void AI::initPicker(mySearch &ss, myMovePicker &mp, int player, uint16_t hashMove, bool quiescence)
+/// @brief This function sets up a move picker for the state of a search
+/// @param ss is the search, its state is the node
+/// @param mp is the move picker
+/// @param player is the player to move
+/// @param hashMove is the best move from the transposition table (packed), 0 if none
+/// @param quiescence is true to pick only the captures and promotions that do not
+/// lose material
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn bool AI::pickMove(mySearch &ss, myMovePicker &mp, myMove &m)
+/// @brief This function gives the legal moves of a node one at a time: the hash
+/// move, then the captures and promotions that do not lose material (by SEE) in
+/// MVV-LVA order (most valuable victim, least valuable attacker), then the killers
+/// and the counter-move, then the captures that lose material, then the other
+/// quiet moves by history score
+/// @param ss is the search, its state is the node
+/// @param mp is the move picker of the node
+/// @param m gets the next move
+/// @return false when there is no move left
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn myMoveScores &AI::pickRemaining(mySearch &ss, myMovePicker &mp, const myMove &first)
+/// @brief This function picks every move left in a node, for a split point
+/// @param ss is the search, its state is the node
+/// @param mp is the move picker of the node
+/// @param first is a move picked already and not searched, it goes first
+/// @return the moves, in the split buffer of the ply of the node
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn bool AI::legalMove(const myState &s, const myMove &m, const myCheckInfo &ci, myMoves &buffer)
+/// @brief This function checks a move that was not generated for the state, like a
+/// hash move or a killer, is one the generator would give
 /// @param s is the current state
+/// @param m is the move
+/// @param ci is the checks and pins of the player of the move
+/// @param buffer is used for the moves of the piece
+/// @return if the move is legal in the state
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::makeMove(mySearch &ss, const myMove &m)
+/// @brief This function plays a legal move on the state of a search and pushes what
+/// is needed to take it back on its undo stack
+/// @param ss is the search, its state s is changed into RESULT(s, m)
 /// @param m is the legal move for state s
-/// @return RESULT(s, m)
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn myStates AI::nextStates(const myState, int player)
-/// @brief This function determine all the possible next states for current state
+/// @fn void AI::unmakeMove(mySearch &ss)
+/// @brief This function takes back the last move made with makeMove
+/// @param ss is the search, its state is changed back into the state before the move
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::makeNullMove(mySearch &ss)
+/// @brief This function passes the turn of the player to move, for null-move pruning
+/// @param ss is the search, the opponent moves next in its state
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::unmakeNullMove(mySearch &ss)
+/// @brief This function takes back the null move made with makeNullMove
+/// @param ss is the search, its state is changed back into the state before it
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn Key AI::computeKey(const myState &s)
+/// @brief This function computes the Zobrist key of a state from scratch. The search
+/// does not need it, makeMove updates the key as the pieces move
+/// @param s is the state
+/// @return The key of the pieces, the side to move, the castling rights and the
+/// en passant file
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn myMoveScores &AI::orderedMoves(mySearch &ss, int player, uint16_t hashMove)
+/// @brief This function determine all the legal moves for current state, best first.
+/// The moves are kept in a buffer for the current ply, so they stay valid while
+/// the moves after them are searched
+/// @param ss is the search, its state is unchanged when the function returns
+/// @param player indicate if we find the moves for white player or black player
+/// @param hashMove is the best move from the transposition table (packed), 0 if none
+/// @return The legal moves for current state, the hash move first, then the captures
+/// and promotions, then the killers and the counter-move, each group sorted by
+/// history score
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::checkInfo(const myState &s, int player, myCheckInfo &ci)
+/// @brief This function finds the pieces that check the king of a player and the
+/// pieces of the player that are pinned to it
 /// @param s is the current state
-/// @param player indicate if we find next states for white player or black player
-/// @return The possible next states for current state
+/// @param player is the player whose king is looked at
+/// @param ci gets the checks and pins
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn myMoves AI::legalMoves(const myState,int player, bool inCheck)
+/// @fn void AI::legalMoves(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function determines all the legal moves for current state
 /// @param s is the current state
 /// @param player determine we find the moves for white player or black player
-/// @param inCheck indicates if the King is in check
-/// @return All the legal moves for current state
+/// @param nextMoves gets all the legal moves for current state
+/// @param ci is the checks and pins of the player, from checkInfo
+/// @param type is which of the moves are added
+////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::evasions(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+/// @brief This function determines the legal moves when the king is in check: the
+/// king moves out of check, and in a single check the other pieces capture the
+/// checker or block it
+/// @param s is the current state
+/// @param player is the player in check
+/// @param nextMoves gets the legal moves
+/// @param ci is the checks and pins of the player, from checkInfo
+/// @param type is which of the moves are added
+////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::pieceMoves(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+/// @brief This function determines the legal moves of all the pieces but the King
+/// @param s is the current state
+/// @param player is the player to move
+/// @param nextMoves gets the legal moves
+/// @param ci is the checks and pins of the player, from checkInfo
+/// @param type is which of the moves are added
 ////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::inCheck(myState s, int player)
+/// @fn bool AI::inCheck(const myState &s, int player)
 /// @brief This function returns if the player in the state can cause a checkmate
 /// @param s is current state
 /// @param player is the Player that can capture the opponent's 'King'
@@ -130,115 +631,163 @@ typedef std::priority_queue<myState, std::vector<myState>, state_comp> myStates;
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::KingMove(myState s, int file, int rank, int player, myMoves &nextMoves, bool)
-/// @brief This function find the possible moves for King and determine if that piece
-/// can capture the opponent's 'King'
+/// @fn bool AI::KingMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
+/// @brief This function find the legal moves for King, to the squares the opponent
+/// does not attack, and determine if that piece can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for the player
-/// @param kingInCheck is the flag indicates if the king is in check
+/// @param ci is the checks and pins of the player, castling is not allowed in check
+/// @param type is which of the moves are added
 /// @return if the player has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::QueenMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/// @fn bool AI::QueenMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function find the possible moves for Queen and determine if the piece
 /// can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for the player
+/// @param ci is the checks and pins of the player, the piece only gets legal moves
+/// @param type is which of the moves are added
 /// @return if the pieces has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::BishopMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/// @fn bool AI::BishopMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function find the possible moves for Bishop and determine if that piece
 /// can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for that piece
+/// @param ci is the checks and pins of the player, the piece only gets legal moves
+/// @param type is which of the moves are added
 /// @return if the piece has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::RookMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/// @fn bool AI::RookMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function find the possible moves for Rook and determine if that piece
 /// can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for that piece
+/// @param ci is the checks and pins of the player, the piece only gets legal moves
+/// @param type is which of the moves are added
 /// @return if the piece has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::KnightMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/// @fn bool AI::KnightMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function find the possible moves for Knight and determine if that piece
 /// can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for that piece
+/// @param ci is the checks and pins of the player, the piece only gets legal moves
+/// @param type is which of the moves are added
 /// @return if the piece has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::PawnMove(myState s, int file, int rank, int player, myMoves &nextMoves)
+/// @fn bool AI::PawnMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type)
 /// @brief This function find the possible moves for Pawn and determine if that piece
 /// can capture the opponent's 'King'
 /// @param s is current state
-/// @param file is the current file
-/// @param rank is the current rank
+/// @param square is the square of the piece
 /// @param player is the Player in turn and that can capture the opponent's 'King'
 /// @param nextMoves contains the possible moves for that piece
+/// @param ci is the checks and pins of the player, the piece only gets legal moves
+/// @param type is which of the moves are added
 /// @return if the piece has potential moves to capture the opponent's 'King'
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::isWhite(char)
-/// @brief This function determines if a piece is for white player or not
-/// @param c is the char for piece on the board
-/// @return If this is a white piece, return true. Otherwise, return false
+/// @fn bool AI::isSquareAttacked(const myState &s, int square, int byColor)
+/// @brief This function looks outward from a square with the attack tables to find
+/// if a piece of a player attacks it
+/// @param s is the current state
+/// @param square is the square
+/// @param byColor is the player of the attackers
+/// @return if a piece of byColor attacks the square
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn bool AI::isBlack(char)
-/// @brief This function determines if a piece is for black player or not
-/// @param c is the char for piece on the board
-/// @return If this is a black piece, return true. Otherwise, return false
+/// @fn Bitboard AI::attackersTo(const myState &s, int square, Bitboard occupied)
+/// @brief This function finds the pieces of both players that attack a square
+/// @param s is the current state
+/// @param square is the square attacked
+/// @param occupied are the squares that block the sliders, so pieces can be taken away
+/// @return the squares of the attackers, not limited to occupied
 /////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn int AI::alphaBetaMax(const myState &s, int alpha, int beta, int depthleft)
-/// @biref This function return max value in minimax
-/// @param s is the current evaluated state
-/// @param alpha is the highest value
-/// @param beta is the lowest value
-/// @param depth left is the depth left for recursion
-///////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::see(const myState &s, const myMove &m)
+/// @brief This function is the static exchange evaluation of a capture: the material
+/// won when both players keep recapturing on the square with their least valuable
+/// attacker, each one stopping when it is better not to go on
+/// @param s is the current state
+/// @param m is a capture or a promotion of the player to move
+/// @return the material won by the player of the move, in pawns, below 0 if it loses
+/////////////////////////////////////////////////////////////////////////////////////
 
 /////////////////////////////////////////////////////////////////////////////////////
-/// @fn int AI::alphaBetaMin(const myState &s, int alpha, int beta, int depthleft)
-/// @biref This function returns min value in minimax
-/// @param s is the current evaluated state
-/// @param alpha is the highest value
-/// @param beta is the lowest value
-/// @param depth left is the depth left for recursion
+/// @fn char AI::pieceAt(const myState &s, int square)
+/// @brief This function finds the piece on a square
+/// @param s is the current state
+/// @param square is the square to look at
+/// @return The letter of the piece, uppercase for white and lowercase for black,
+/// or ' ' if the square is empty
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::pieceTypeAt(const myState &s, int square, int player)
+/// @brief This function finds the type of a player's piece on a square
+/// @param s is the current state
+/// @param square is the square to look at
+/// @param player is the owner of the piece
+/// @return The PieceType of the piece, or NO_PIECE if the player has no piece there
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn template<NodeType nt> int AI::search(mySearch &ss, int alpha, int beta, int depthleft, uint16_t excluded)
+/// @brief This function is the negamax alpha-beta search, the scores are for the
+/// player to move and the score of a move is minus the score of the state after it
+/// @param nt is the kind of node, the ROOT also sets mySearch::rootMove
+/// @param ss is the search, its state is the current evaluated state
+/// @param alpha is the score the player to move is assured of
+/// @param beta is the score the opponent is assured of
+/// @param depthleft is the depth left for recursion
+/// @param excluded is a packed move not searched, to test whether it is singular. The
+/// score then does not go to the transposition table
+/// @return the score of the state
 ///////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////////
-/// @fn int AI::evaluate(const myState &s)
-/// @brief This function returns the evaluation for state s
-/// @param s is the state for evaluation
-/// @return the score for state s
+/// @fn template<NodeType nt> int AI::qsearch(mySearch &ss, int alpha, int beta)
+/// @brief This function is the quiescence search, where search stops. Only the
+/// captures and promotions are searched, until there are none left, and the static
+/// evaluation is a lower bound (stand pat) since the player does not have to
+/// capture. In check every move is searched instead
+/// @param nt is the kind of node, PV or NON_PV
+/// @param ss is the search, its state is the current evaluated state
+/// @param alpha is the score the player to move is assured of
+/// @param beta is the score the opponent is assured of
+/// @return the score of the state
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::evaluate(const mySearch &ss)
+/// @brief This function returns the evaluation for the state of a search
+/// @param ss is the search, its state is the state for evaluation and its undo
+/// stack gives the positions before it for the repetition check
+/// @return the score for the state
 /////////////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -248,6 +797,177 @@ typedef std::priority_queue<myState, std::vector<myState>, state_comp> myStates;
 /// @return the score for state s
 /////////////////////////////////////////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn bool AI::isRepetition(const mySearch &ss)
+/// @brief This function says if the state of a search was already reached, in the
+/// search or in the game. Only the positions since the last capture or pawn move are
+/// looked at, the ones before can not come again, and none before a null move
+/// @param ss is the search, its undo stack keeps the key of every state before it
+/// @return true if the state is a repetition
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::replayGame(const myState &root)
+/// @brief This function plays the moves of the game from the initial position, for
+/// the keys of the positions since the last capture or pawn move (gameKeys) and the
+/// last game move (gameMoves). When the moves do not lead to the root, the game did
+/// not start from the initial position and only the last move is kept, without keys
+/// @param root is the state of the game now
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::aspirationSearch(mySearch &ss, int depth, int lastScore)
+/// @brief This function searches the root with an aspiration window around the score
+/// of the last depth. When the score falls outside, the window is widened on that
+/// side and the root is searched again
+/// @param ss is the search, its state is the root state
+/// @param depth is the depth of the search
+/// @param lastScore is the score of the last depth
+/// @return the score of the root, its move is in mySearch::rootMove
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::historyBonus(mySearch &ss, const myMove &m, int depthleft)
+/// @brief This function raises the history score of a move that caused a cutoff, by
+/// more for deeper cutoffs. The bonus shrinks as the score gets closer to
+/// HISTORY_MAX (gravity), so the scores stay bounded and new cutoffs still count
+/// @param ss is the search of the thread
+/// @param m is the move that caused the cutoff
+/// @param depthleft is the depth left at the node of the cutoff
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::quietCutoff(mySearch &ss, const myMove &m)
+/// @brief This function stores a quiet move that caused a cutoff as the first killer
+/// of the ply and as the counter-move of the move before it
+/// @param ss is the search of the thread, at the node of the cutoff
+/// @param m is the move that caused the cutoff, not a capture or a promotion
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::ageHistory(mySearch &ss)
+/// @brief This function halves every history score, between two iterations, so the
+/// cutoffs of the last iterations count more than the older ones
+/// @param ss is the search of the thread
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::checkTime(const mySearch &ss)
+/// @brief This function stops the search when the time of the move is up. Only the
+/// main thread looks at the clock, every 1024 states, and while it waits for the
+/// helpers of one of its split points in AI::idleLoop
+/// @param ss is the search of the thread
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn bool AI::stopped(const mySearch &ss)
+/// @brief This function says if the result of the current search of a thread is not
+/// needed anymore, because the main thread has its move or a split point the thread
+/// is under had a cutoff
+/// @param ss is the search of the thread
+/// @return true if the thread has to return from its search
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn bool AI::canSplit(const mySearch &ss, int depthleft)
+/// @brief This function says if the younger brothers of a node are worth searching
+/// with the other threads
+/// @param ss is the search of the thread at the node
+/// @param depthleft is the depth left at the node
+/// @return true if the YBW backend is used, a thread is idle and the node is deep enough
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::extension(mySearch &ss, int singular)
+/// @brief This function gives the extension of the move just made: a check, a
+/// recapture or a pawn push to the 7th rank. It adds it to the extensions of the
+/// line, within EXTENSION_BUDGET, and sets mySearch::extended for the new ply
+/// @param ss is the search of the thread, just after the move
+/// @param singular is the singular extension of the move, 0 if none
+/// @return the plies added to the depth of the move, whole plies of the line only
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::searchLateMove(mySearch &ss, const myMove &m, int moveCount, int depthleft, int alpha, int beta, bool pvNode, bool checked)
+/// @brief This function searches a younger brother of a node (Principal Variation
+/// Search with late move reductions). A late quiet move is first searched with a
+/// reduced depth and a zero window, then at full depth if it beats alpha, and at a
+/// PV node again with the full window if it is inside it
+/// @param ss is the search of the thread at the node, its state is the node
+/// @param m is the move, not the first of the node
+/// @param moveCount is the number of the move in the node, from 1
+/// @param depthleft is the depth left at the node
+/// @param alpha, beta is the window of the node
+/// @param pvNode is true at a ROOT or PV node
+/// @param checked is true if the player to move is in check at the node
+/// @return the score of the move for the player to move
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn int AI::split(mySearch &ss, const myMoveScores &moves, size_t first, int depthleft, int alpha, int beta, bool pvNode, bool checked, myMove &bestMove)
+/// @brief This function searches the moves of a node left after the eldest brother,
+/// with any idle thread helping. It returns when every thread is done with the node
+/// @param ss is the search of the thread at the node, its state is the node
+/// @param moves are the moves of the node
+/// @param first is the index of the first move not searched yet
+/// @param depthleft is the depth left at the node
+/// @param alpha, beta is the window of the node after the first move
+/// @param pvNode is true at a ROOT or PV node
+/// @param checked is true if the player to move is in check at the node
+/// @param bestMove gets the best of the moves
+/// @return the score of bestMove, or the score of the move with the cutoff
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::searchSplitPoint(mySearch &ss, mySplitPoint *sp)
+/// @brief This function takes the moves of a split point one at a time and searches
+/// them, until there are none left or the split point had a cutoff
+/// @param ss is the search of the thread, its state is the state of the split point
+/// @param sp is the split point
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::closeSplit(mySplitPoint *sp)
+/// @brief This function says that a split point has no more moves to give, once
+/// its last move is taken, it had a cutoff or the search stopped
+/// @param sp is the split point
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::idleLoop(mySearch &ss, mySplitPoint *master)
+/// @brief This function is where a thread waits for work with the YBW backend. It
+/// steals moves from the oldest split point of the other threads that has some left.
+/// The owner of a split point waits here too, but only helps with the split points
+/// under its own, so it is free as soon as its split point is done. It then takes
+/// the split point off its list, so no thread can join it any more
+/// @param ss is the search of the thread
+/// @param master is the split point the thread waits for, NULL for a helper thread,
+/// which then returns when the main thread has its move
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::setSearchThreads(int threads, SearchBackend backend)
+/// @brief This function changes the number of threads and how they share the work,
+/// for the next searches
+/// @param threads is the number of threads, at least 1
+/// @param backend is how the threads share the work
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::setSearchDepth(int depth)
+/// @brief This function sets the deepest iteration of the next searches, they stop
+/// earlier when the time is up
+/// @param depth is the depth, at least 1
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+/// @fn void AI::helperSearch(mySearch &ss)
+/// @brief This function runs on the helper threads. They search the same root as the
+/// main thread with iterative deepening, half of them one depth ahead, until the
+/// main thread stops them. They only help through the transposition table
+/// @param ss is the search of the thread, set up with the root state
+/////////////////////////////////////////////////////////////////////////////////////
+
 ////////////////////////////////////////////////////////////////////////////////////
 /// @fn time_t AI::timeHave()
 /// @brief This function returns the time for the search
@@ -267,47 +987,143 @@ public:
   
   virtual myMove nextMove(const myState &oldState);
   
-  virtual myState newState(myState s, const myMove &m, int player);
+  virtual void makeMove(mySearch &ss, const myMove &m);
+  
+  virtual void unmakeMove(mySearch &ss);
+  
+  virtual void makeNullMove(mySearch &ss);
+  
+  virtual void unmakeNullMove(mySearch &ss);
   
-  virtual myStates nextStates(const myState &s, int player);
+  virtual Key computeKey(const myState &s);
   
-  virtual myMoves legalMoves(const myState &s, int player, bool kingInCheck = false);
+  virtual myMoveScores &orderedMoves(mySearch &ss, int player, uint16_t hashMove = 0);
+  
+  virtual void initPicker(mySearch &ss, myMovePicker &mp, int player, uint16_t hashMove, bool quiescence = false);
+  
+  virtual bool pickMove(mySearch &ss, myMovePicker &mp, myMove &m);
+  
+  virtual myMoveScores &pickRemaining(mySearch &ss, myMovePicker &mp, const myMove &first);
+  
+  virtual bool legalMove(const myState &s, const myMove &m, const myCheckInfo &ci, myMoves &buffer);
+  
+  virtual void checkInfo(const myState &s, int player, myCheckInfo &ci);
+  
+  virtual void legalMoves(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
+  
+  virtual void evasions(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
+  
+  virtual void pieceMoves(const myState &s, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
   virtual bool inCheck(const myState &s, int player);
   
-  virtual bool KingMove(myState s, int file, int rank, int player, myMoves &nextMoves, bool kingInCheck = false);
+  virtual bool isSquareAttacked(const myState &s, int square, int byColor);
+  
+  virtual bool KingMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool QueenMove(myState s, int file, int rank, int player, myMoves &nextMoves);
+  virtual bool QueenMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool BishopMove(myState s, int file, int rank, int player, myMoves &nextMoves);
+  virtual bool BishopMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool RookMove(myState s, int file, int rank, int player, myMoves &nextMoves);
+  virtual bool RookMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool KnightMove(myState s, int file, int rank, int player, myMoves &nextMoves);
+  virtual bool KnightMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool PawnMove(myState s, int file, int rank, int player, myMoves &nextMoves);
+  virtual bool PawnMove(const myState &s, int square, int player, myMoves &nextMoves, const myCheckInfo &ci, GenType type = GEN_ALL);
   
-  virtual bool isWhite(char c);
+  virtual Bitboard attackersTo(const myState &s, int square, Bitboard occupied);
   
-  virtual bool isBlack(char c);
+  virtual int see(const myState &s, const myMove &m);
   
-  virtual int alphaBetaMax(const myState &s, int alpha, int beta, int depthleft);
+  virtual char pieceAt(const myState &s, int square);
   
-  virtual int alphaBetaMin(const myState &s, int alpha, int beta, int depthleft);
+  virtual int pieceTypeAt(const myState &s, int square, int player);
   
-  virtual int evaluate(const myState &s);
+  template<NodeType nt> int search(mySearch &ss, int alpha, int beta, int depthleft, uint16_t excluded = 0);
+  
+  virtual int evaluate(const mySearch &ss);
   
   virtual int drawOrWin(const myState &s);
   
-  virtual int QSMin(const myState &s, int depth, int alpha, int beta);
+  virtual bool isRepetition(const mySearch &ss);
+  
+  virtual void replayGame(const myState &root);
+  
+  template<NodeType nt> int qsearch(mySearch &ss, int alpha, int beta);
+  
+  virtual int aspirationSearch(mySearch &ss, int depth, int lastScore);
+  
+  virtual void helperSearch(mySearch &ss);
+  
+  virtual void historyBonus(mySearch &ss, const myMove &m, int depthleft);
+  
+  virtual void quietCutoff(mySearch &ss, const myMove &m);
+  
+  virtual void ageHistory(mySearch &ss);
+  
+  virtual void checkTime(const mySearch &ss);
+  
+  virtual bool stopped(const mySearch &ss);
+  
+  virtual bool canSplit(const mySearch &ss, int depthleft);
+  
+  virtual int extension(mySearch &ss, int singular);
+  
+  virtual int searchLateMove(mySearch &ss, const myMove &m, int moveCount, int depthleft, int alpha, int beta, bool pvNode, bool checked);
+  
+  virtual int split(mySearch &ss, const myMoveScores &moves, size_t first, int depthleft, int alpha, int beta, bool pvNode, bool checked, myMove &bestMove);
+  
+  virtual void searchSplitPoint(mySearch &ss, mySplitPoint *sp);
+  
+  virtual void closeSplit(mySplitPoint *sp);
+  
+  virtual void idleLoop(mySearch &ss, mySplitPoint *master);
+  
+  virtual void setSearchThreads(int threads, SearchBackend backend);
   
-  virtual int QSMax(const myState &s, int depth, int alpha, int beta);
+  virtual void setSearchDepth(int depth);
   
   virtual time_t timeHave();
   
   private:
-		//history table for two players, differ from 'player' in myMove
-		std::map<myMove, int, move_comp> history;
+		//search results shared by every search of the game
+		TranspositionTable tt;
+		
+		//the number of threads searching each move
+		int threadCount;
+		
+		//how the threads share the work of a search
+		SearchBackend backend;
+		
+		//the deepest iteration of a search
+		int searchDepth;
+		
+		//the time the main thread stops the search at
+		time_t stopTime;
+		
+		//one search for each thread, the first one is the main thread's
+		std::vector<mySearch> searches;
+		
+		//set by the main thread when it has its move, the helper threads then return
+		std::atomic<bool> stopSearch;
+		
+		//the last game move, copied to the undo stack of each search for the counter-move and
+		//the recapture of the first ply
+		myUndos gameMoves;
+		
+		//the keys of the game positions since the last capture or pawn move, the oldest first
+		//and without the root, for the repetitions
+		myList<Key, MAX_GAME_KEYS> gameKeys;
+		
+		//guards the lists of split points of every search and the threads joining them (YBW backend)
+		std::mutex splitLock;
+		
+		//the number of split points with moves left to give, the idle threads only look for
+		//one when there is some (YBW backend)
+		std::atomic<int> openSplits;
+		
+		//the number of helper threads waiting for a split point to join (YBW backend)
+		std::atomic<int> idleThreads;
  
 };
 
@@ -0,0 +1,243 @@
+//Times the search of a few positions with different thread counts and backends.
+//Build it with "make bench" and run it as "bench/bench [threads] [depth] [runs]". The
+//Makefile builds without optimizations, which makes every search several times slower
+//and the timings meaningless, so build the timed objects with "CXXFLAGS=-O2 make bench".
+//"bench/bench perft" instead counts the leaves of the legal move tree of positions
+//with known counts, to check the move generator.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include "../AI.h"
+#include "../game.h"
+
+//The positions, as FEN strings (piece placement, side to move, castling, en passant)
+static const char *positions[] =
+{
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+	"r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R w KQkq -",
+	"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ -",
+	"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - -",
+};
+
+//The perft positions, with their depth and known leaf count: the start position,
+//Kiwipete, and positions full of en passant, castling and promotion edge cases
+static const struct
+{
+	const char *fen;
+	int depth;
+	long leaves;
+} perftPositions[] =
+{
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 6, 119060324},
+	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 5, 193690690},
+	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 6, 11030083},
+	{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq -", 5, 15833292},
+	{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ -", 5, 89941194},
+};
+
+//Every heap allocation of the program, the search itself should make none
+static std::atomic<long> allocations(0);
+
+void *operator new(size_t size)
+{
+	allocations++;
+	void *p = malloc(size ? size : 1);
+	if(!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+//The depth every position is searched to, deep enough for a search to take seconds on one
+//thread of an optimized build
+static int depth = 20;
+
+//How many times every backend searches the positions, the timings vary between runs
+static int runs = 3;
+
+//An AI that searches to the full depth without looking at the clock
+class BenchAI: public AI
+{
+public:
+	BenchAI(Connection *c) : AI(c) {}
+	virtual time_t timeHave() { return time(NULL) + 1000000; }
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//Fills s from a FEN string and returns the side to move
+static int loadFen(AI &ai, myState &s, const char *fen)
+{
+	memset(&s, 0, sizeof(s));
+	s.epSquare = NO_SQUARE;
+	int file = 0, rank = 0;
+	const char *c = fen;
+	for(; *c && *c != ' '; c++)
+	{
+		if(*c == '/')
+		{
+			rank++;
+			file = 0;
+		}
+		else if(isdigit(*c))
+		{
+			file += *c - '0';
+		}
+		else
+		{
+			int color = isupper(*c) ? WHITE : BLACK;
+			s.pieces[color][charPieceType(*c)] |= squareBB(makeSquare(file, rank));
+			s.occupied[color] |= squareBB(makeSquare(file, rank));
+			file++;
+		}
+	}
+	s.sideToMove = c[1] == 'b' ? BLACK : WHITE;
+	for(c += 3; *c && *c != ' '; c++)
+	{
+		switch(*c)
+		{
+			case 'K': s.castling |= WHITE_OO; break;
+			case 'Q': s.castling |= WHITE_OOO; break;
+			case 'k': s.castling |= BLACK_OO; break;
+			case 'q': s.castling |= BLACK_OOO; break;
+		}
+	}
+	if(*c == ' ' && c[1] != '-' && c[1] != '\0')
+	{
+		s.epSquare = makeSquare(c[1] - 'a', '8' - c[2]);
+	}
+	s.key = ai.computeKey(s);
+	return s.sideToMove;
+}
+
+//Searches every position and returns the total time
+static double run(Connection *c, int threads, SearchBackend backend)
+{
+	double total = 0;
+	for(size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+	{
+		//a new AI for each position, so it starts with an empty transposition table
+		BenchAI ai(c);
+		ai.setSearchThreads(threads, backend);
+		ai.setSearchDepth(depth);
+		ai.init();
+		myState s;
+		c->playerID = loadFen(ai, s, positions[i]);
+		long allocated = allocations;
+		double start = now();
+		ai.nextMove(s);
+		double t = now() - start;
+		printf("position %d: %.3fs, %ld allocations\n", int(i), t, allocations - allocated);
+		total += t;
+	}
+	return total;
+}
+
+//Counts the leaves of the legal move tree of ss.state, depth plies deep
+static long perft(AI &ai, mySearch &ss, int depth)
+{
+	myCheckInfo ci;
+	myMoves moves;
+	ai.checkInfo(ss.state, ss.state.sideToMove, ci);
+	ai.legalMoves(ss.state, ss.state.sideToMove, moves, ci);
+	if(depth == 1)
+	{
+		return moves.size();
+	}
+	long leaves = 0;
+	for(size_t i = 0; i < moves.size(); i++)
+	{
+		ai.makeMove(ss, moves[i]);
+		leaves += perft(ai, ss, depth - 1);
+		ai.unmakeMove(ss);
+	}
+	return leaves;
+}
+
+//Checks the move generator against the known perft counts, returns the number of mismatches
+static int runPerft(Connection *c)
+{
+	int failed = 0;
+	for(size_t i = 0; i < sizeof(perftPositions) / sizeof(perftPositions[0]); i++)
+	{
+		BenchAI ai(c);
+		ai.init();
+		//a search is too big for the stack
+		std::vector<mySearch> ss(1);
+		c->playerID = loadFen(ai, ss[0].state, perftPositions[i].fen);
+		double start = now();
+		long leaves = perft(ai, ss[0], perftPositions[i].depth);
+		bool ok = leaves == perftPositions[i].leaves;
+		printf("perft %d, depth %d: %ld leaves, expected %ld, %s (%.3fs)\n", int(i), perftPositions[i].depth,
+			leaves, perftPositions[i].leaves, ok ? "ok" : "MISMATCH", now() - start);
+		failed += !ok;
+	}
+	return failed;
+}
+
+//Searches the positions runs times and prints the median time and the range
+static double timeToDepth(Connection *c, int threads, SearchBackend backend, const char *name, double base)
+{
+	std::vector<double> times;
+	for(int i = 0; i < runs; i++)
+	{
+		times.push_back(run(c, threads, backend));
+	}
+	std::sort(times.begin(), times.end());
+	double median = times[times.size() / 2];
+	printf("time to depth, %2d threads, %-8s: %.3fs (%.3fs - %.3fs, %d runs)", threads, name, median,
+		times.front(), times.back(), runs);
+	if(base > 0)
+	{
+		printf(", speedup %.2f", base / median);
+	}
+	printf("\n");
+	fflush(stdout);
+	return median;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1 && strcmp(argv[1], "perft") == 0)
+	{
+		Connection *c = createConnection();
+		initBitboards();
+		initZobrist();
+		return runPerft(c) ? 1 : 0;
+	}
+	
+	int threads = argc > 1 ? atoi(argv[1]) : 4;
+	depth = argc > 2 ? atoi(argv[2]) : depth;
+	runs = argc > 3 ? std::max(atoi(argv[3]), 1) : runs;
+	Connection *c = createConnection();
+	initBitboards();
+	initZobrist();
+	
+	double base = timeToDepth(c, 1, LAZY_SMP, "serial", 0);
+	timeToDepth(c, threads, LAZY_SMP, "Lazy SMP", base);
+	timeToDepth(c, threads, YBW, "YBW", base);
+	return 0;
+}
@@ -0,0 +1,240 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "bitboard.h"
+
+Bitboard KnightAttacks[64];
+Bitboard KingAttacks[64];
+Bitboard PawnAttacks[2][64];
+Bitboard BetweenSquares[64][64];
+Bitboard LineSquares[64][64];
+
+bool UsePext = false;
+Magic BishopMagics[64];
+Magic RookMagics[64];
+
+//Every occupancy of every square, 4 to 9 bits for bishops and 10 to 12 bits for rooks
+static Bitboard BishopTable[0x1480];
+static Bitboard RookTable[0x19000];
+
+static const int BishopDX[4] = {1, -1, 1, -1};
+static const int BishopDY[4] = {1, -1, -1, 1};
+static const int RookDX[4] = {0, 0, 1, -1};
+static const int RookDY[4] = {1, -1, 0, 0};
+
+/*************************************************************************/
+//The square at file+df, rank+dr as a bitboard, or an empty bitboard if it is off the board
+static Bitboard offsetBB(int sq, int df, int dr)
+{
+	int file = fileOf(sq) + df;
+	int rank = rankOf(sq) + dr;
+	if(file < 0 || file > 7 || rank < 0 || rank > 7)
+	{
+		return 0;
+	}
+	return squareBB(makeSquare(file, rank));
+}
+
+/*************************************************************************/
+//Walks the four rays given by dFile/dRank until the edge of the board or the first blocker
+static Bitboard slidingAttacks(int sq, Bitboard occupied, const int dFile[4], const int dRank[4])
+{
+	Bitboard attacks = 0;
+	for(int d = 0; d < 4; d++)
+	{
+		for(int i = 1; i <= 7; i++)
+		{
+			Bitboard b = offsetBB(sq, dFile[d] * i, dRank[d] * i);
+			attacks |= b;
+			if(!b || (occupied & b))
+			{
+				break;
+			}
+		}
+	}
+	return attacks;
+}
+
+/*************************************************************************/
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("bmi2")))
+Bitboard pextBits(Bitboard b, Bitboard mask)
+{
+	return _pext_u64(b, mask);
+}
+#else
+//no PEXT off x86, UsePext is never set there
+Bitboard pextBits(Bitboard b, Bitboard mask)
+{
+	Bitboard result = 0;
+	for(Bitboard bit = 1; mask; mask &= mask - 1, bit <<= 1)
+	{
+		if(b & mask & -mask)
+		{
+			result |= bit;
+		}
+	}
+	return result;
+}
+#endif
+
+/*************************************************************************/
+uint64_t random64(uint64_t &seed)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+/*************************************************************************/
+//Fills the table of one slider type, with 'table' large enough for every square
+static void initMagics(Magic magics[64], Bitboard *table, const int dFile[4], const int dRank[4])
+{
+	//seeds that find the magics for each rank quickly
+	static const uint64_t seeds[8] = {255, 16645, 15100, 12281, 32803, 55013, 10316, 728};
+	Bitboard occupancy[4096], reference[4096];
+	int epoch[4096] = {0};
+	int attempt = 0;
+	
+	for(int sq = 0; sq < 64; sq++)
+	{
+		Magic &m = magics[sq];
+		
+		//the squares at the edge of the board can not block anything
+		Bitboard edges = ((0xFFULL | 0xFF00000000000000ULL) & ~(0xFFULL << (8 * rankOf(sq))))
+			| ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << fileOf(sq)));
+		m.mask = slidingAttacks(sq, 0, dFile, dRank) & ~edges;
+		m.shift = 64 - popCount(m.mask);
+		m.attacks = sq == 0 ? table : magics[sq - 1].attacks + (1 << (64 - magics[sq - 1].shift));
+		
+		//enumerate every subset of the mask with the Carry-Rippler trick
+		int size = 0;
+		Bitboard b = 0;
+		do
+		{
+			occupancy[size] = b;
+			reference[size] = slidingAttacks(sq, b, dFile, dRank);
+			if(UsePext)
+			{
+				m.attacks[pextBits(b, m.mask)] = reference[size];
+			}
+			size++;
+			b = (b - m.mask) & m.mask;
+		} while(b);
+		
+		if(UsePext)
+		{
+			continue;
+		}
+		
+		//find a magic that maps every occupancy to an index with the right attacks
+		uint64_t seed = seeds[rankOf(sq)];
+		for(int i = 0; i < size; )
+		{
+			for(m.magic = 0; popCount((m.magic * m.mask) >> 56) < 6; )
+			{
+				m.magic = random64(seed) & random64(seed) & random64(seed);
+			}
+			
+			attempt++;
+			for(i = 0; i < size; i++)
+			{
+				unsigned idx = unsigned(((occupancy[i] & m.mask) * m.magic) >> m.shift);
+				if(epoch[idx] < attempt)
+				{
+					epoch[idx] = attempt;
+					m.attacks[idx] = reference[i];
+				}
+				else if(m.attacks[idx] != reference[i])
+				{
+					break;
+				}
+			}
+		}
+	}
+}
+
+/*************************************************************************/
+void initBitboards()
+{
+#if defined(__BMI2__)
+	UsePext = true;
+#elif defined(__x86_64__) || defined(__i386__)
+	UsePext = __builtin_cpu_supports("bmi2");
+#else
+	UsePext = false;
+#endif
+	
+	for(int sq = 0; sq < 64; sq++)
+	{
+		KnightAttacks[sq] = 0;
+		KingAttacks[sq] = 0;
+		for(int i = -2; i <= 2; i++)
+		{
+			for(int j = -2; j <= 2; j++)
+			{
+				if(i != 0 && j != 0 && i != j && i != -j)
+				{
+					KnightAttacks[sq] |= offsetBB(sq, j, i);
+				}
+				if((i != 0 || j != 0) && i >= -1 && i <= 1 && j >= -1 && j <= 1)
+				{
+					KingAttacks[sq] |= offsetBB(sq, j, i);
+				}
+			}
+		}
+		//white pawns move towards rank 0, black pawns towards rank 7
+		PawnAttacks[WHITE][sq] = offsetBB(sq, -1, -1) | offsetBB(sq, 1, -1);
+		PawnAttacks[BLACK][sq] = offsetBB(sq, -1, 1) | offsetBB(sq, 1, 1);
+	}
+	
+	initMagics(BishopMagics, BishopTable, BishopDX, BishopDY);
+	initMagics(RookMagics, RookTable, RookDX, RookDY);
+	
+	//the line and the squares between two squares come from the slider attacks between them
+	for(int s1 = 0; s1 < 64; s1++)
+	{
+		for(int s2 = 0; s2 < 64; s2++)
+		{
+			BetweenSquares[s1][s2] = 0;
+			LineSquares[s1][s2] = 0;
+			if(s1 == s2)
+			{
+				continue;
+			}
+			if(bishopAttacks(s1, 0) & squareBB(s2))
+			{
+				BetweenSquares[s1][s2] = bishopAttacks(s1, squareBB(s2)) & bishopAttacks(s2, squareBB(s1));
+				LineSquares[s1][s2] = (bishopAttacks(s1, 0) & bishopAttacks(s2, 0)) | squareBB(s1) | squareBB(s2);
+			}
+			if(rookAttacks(s1, 0) & squareBB(s2))
+			{
+				BetweenSquares[s1][s2] = rookAttacks(s1, squareBB(s2)) & rookAttacks(s2, squareBB(s1));
+				LineSquares[s1][s2] = (rookAttacks(s1, 0) & rookAttacks(s2, 0)) | squareBB(s1) | squareBB(s2);
+			}
+		}
+	}
+}
+
+/*************************************************************************/
+char pieceTypeChar(int type)
+{
+	static const char letters[] = "PNBRQK";
+	return letters[type];
+}
+
+/*************************************************************************/
+int charPieceType(int c)
+{
+	switch(c)
+	{
+		case 'P': case 'p': return PAWN;
+		case 'N': case 'n': return KNIGHT;
+		case 'B': case 'b': return BISHOP;
+		case 'R': case 'r': return ROOK;
+		case 'Q': case 'q': return QUEEN;
+		case 'K': case 'k': return KING;
+	}
+	return NO_PIECE;
+}
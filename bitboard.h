@@ -0,0 +1,152 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+///A set of squares, one bit per square.
+///Squares are numbered rank * 8 + file, where rank 0 is the 8th rank (black's back rank)
+///and file 0 is the 'a' file, so square 0 is a8 and square 63 is h1. This is the same
+///orientation as the rank/file fields of myMove.
+typedef uint64_t Bitboard;
+
+///The two sides, numbered the same way as BaseAI::playerID()
+enum Color { WHITE = 0, BLACK = 1 };
+
+///The piece types, used to index myState::pieces
+enum PieceType { PAWN = 0, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_PIECE };
+
+///No square, used for an empty en passant square
+const int NO_SQUARE = -1;
+
+///All the light squares (a8 is light)
+const Bitboard LightSquares = 0xAA55AA55AA55AA55ULL;
+
+///Squares attacked by a knight on each square
+extern Bitboard KnightAttacks[64];
+///Squares attacked by a king on each square
+extern Bitboard KingAttacks[64];
+///Squares attacked by a pawn of each color on each square
+extern Bitboard PawnAttacks[2][64];
+///The squares strictly between two squares on the same rank, file or diagonal, empty otherwise
+extern Bitboard BetweenSquares[64][64];
+///The whole rank, file or diagonal through two squares, empty if they are not on one
+extern Bitboard LineSquares[64][64];
+
+///True when the CPU has BMI2, the slider tables are then indexed with PEXT instead of magics
+extern bool UsePext;
+
+///Extracts the bits of b selected by mask (the BMI2 PEXT instruction), only used when UsePext is set
+Bitboard pextBits(Bitboard b, Bitboard mask);
+
+///The slider attack table for one square.
+///The occupied squares that can block the slider are hashed into an index of 'attacks',
+///either with a magic multiply or, when the CPU has it, with PEXT.
+struct Magic
+{
+	///The squares whose occupancy changes the attacks (the rays without the board edge)
+	Bitboard mask;
+	///The magic multiplier
+	Bitboard magic;
+	///The attacks for every occupancy of the mask
+	Bitboard *attacks;
+	///64 minus the number of bits in mask
+	unsigned shift;
+	
+	///The index in 'attacks' for the given occupied squares
+	unsigned index(Bitboard occupied) const
+	{
+#ifdef __BMI2__
+		return unsigned(_pext_u64(occupied, mask));
+#else
+		if(UsePext)
+		{
+			return unsigned(pextBits(occupied, mask));
+		}
+		return unsigned(((occupied & mask) * magic) >> shift);
+#endif
+	}
+};
+
+extern Magic BishopMagics[64];
+extern Magic RookMagics[64];
+
+///Fills the attack tables, must be called once before any other function here is used
+void initBitboards();
+
+///Squares attacked by a bishop on sq, given the occupied squares
+inline Bitboard bishopAttacks(int sq, Bitboard occupied)
+{
+	const Magic &m = BishopMagics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+///Squares attacked by a rook on sq, given the occupied squares
+inline Bitboard rookAttacks(int sq, Bitboard occupied)
+{
+	const Magic &m = RookMagics[sq];
+	return m.attacks[m.index(occupied)];
+}
+
+///Squares attacked by a queen on sq, given the occupied squares
+inline Bitboard queenAttacks(int sq, Bitboard occupied)
+{
+	return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+}
+
+///The square for a file and rank, both 0-7 in myMove orientation
+inline int makeSquare(int file, int rank)
+{
+	return rank * 8 + file;
+}
+
+///The file (0-7) of a square
+inline int fileOf(int sq)
+{
+	return sq & 7;
+}
+
+///The rank (0-7, myMove orientation) of a square
+inline int rankOf(int sq)
+{
+	return sq >> 3;
+}
+
+///The bitboard with only sq set
+inline Bitboard squareBB(int sq)
+{
+	return 1ULL << sq;
+}
+
+///The number of squares in b
+inline int popCount(Bitboard b)
+{
+	return __builtin_popcountll(b);
+}
+
+///The lowest square in b, b must not be empty
+inline int lsb(Bitboard b)
+{
+	return __builtin_ctzll(b);
+}
+
+///Removes the lowest square from b and returns it, b must not be empty
+inline int popLsb(Bitboard &b)
+{
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+
+///Pseudo random numbers (xorshift64star), the same seed always gives the same sequence
+uint64_t random64(uint64_t &seed);
+
+///The letter the server uses for a piece type. K=King, Q=Queen, B=Bishop, N=Knight, R=Rook, P=Pawn
+char pieceTypeChar(int type);
+
+///The piece type for one of the server's piece letters, either case
+int charPieceType(int c);
+
+#endif
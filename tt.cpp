@@ -0,0 +1,123 @@
+#include <string.h>
+#include "tt.h"
+
+TranspositionTable::TranspositionTable() : table(NULL), clusterMask(0), generation(0) {}
+
+TranspositionTable::~TranspositionTable()
+{
+	delete[] table;
+}
+
+/*************************************************************************/
+//TTData and the 64 bits stored in a TTEntry
+static uint64_t toBits(const TTData &d)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &d, sizeof(d));
+	return bits;
+}
+
+static TTData fromBits(uint64_t bits)
+{
+	TTData d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+/*************************************************************************/
+void TranspositionTable::resize(size_t mb)
+{
+	size_t clusters = 1;
+	while(clusters * 2 * sizeof(TTCluster) <= mb * 1024 * 1024)
+	{
+		clusters *= 2;
+	}
+	
+	delete[] table;
+	table = new TTCluster[clusters];
+	clusterMask = clusters - 1;
+	clear();
+}
+
+/*************************************************************************/
+void TranspositionTable::clear()
+{
+	for(size_t i = 0; i <= clusterMask; i++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			table[i].entry[j].keyXorData.store(0, std::memory_order_relaxed);
+			table[i].entry[j].data.store(0, std::memory_order_relaxed);
+		}
+	}
+	generation = 0;
+}
+
+/*************************************************************************/
+void TranspositionTable::newSearch()
+{
+	//the generation lives above the 2 bound bits
+	generation += 4;
+}
+
+/*************************************************************************/
+bool TranspositionTable::probe(Key key, TTData &data) const
+{
+	const TTCluster &cluster = table[key & clusterMask];
+	for(int i = 0; i < 4; i++)
+	{
+		uint64_t bits = cluster.entry[i].data.load(std::memory_order_relaxed);
+		if((cluster.entry[i].keyXorData.load(std::memory_order_relaxed) ^ bits) == key)
+		{
+			data = fromBits(bits);
+			return data.bound() != BOUND_NONE;
+		}
+	}
+	return false;
+}
+
+/*************************************************************************/
+void TranspositionTable::store(Key key, int score, Bound bound, int depth, uint16_t move)
+{
+	TTCluster &cluster = table[key & clusterMask];
+	TTEntry *replace = NULL;
+	int replaceValue = 0;
+	
+	for(int i = 0; i < 4; i++)
+	{
+		TTEntry &e = cluster.entry[i];
+		uint64_t bits = e.data.load(std::memory_order_relaxed);
+		TTData old = fromBits(bits);
+		
+		//the same position, or an empty entry
+		if((e.keyXorData.load(std::memory_order_relaxed) ^ bits) == key || old.bound() == BOUND_NONE)
+		{
+			replace = &e;
+			//keep the old best move when this search did not find one
+			if(move == 0 && old.bound() != BOUND_NONE)
+			{
+				move = old.move;
+			}
+			break;
+		}
+		
+		//otherwise replace the shallowest entry, counting old searches as 8 plies less
+		int age = uint8_t(generation - (old.genBound & 0xFC)) / 4;
+		int value = old.depth - 8 * age;
+		if(replace == NULL || value < replaceValue)
+		{
+			replace = &e;
+			replaceValue = value;
+		}
+	}
+	
+	TTData d;
+	d.move = move;
+	d.score = int16_t(score);
+	d.depth = int8_t(depth);
+	d.genBound = uint8_t(generation | bound);
+	
+	uint64_t bits = toBits(d);
+	replace->data.store(bits, std::memory_order_relaxed);
+	replace->keyXorData.store(key ^ bits, std::memory_order_relaxed);
+}
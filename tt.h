@@ -0,0 +1,87 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <atomic>
+#include "zobrist.h"
+
+///Size of the transposition table in megabytes, set it with -DTT_MB=<size> in the Makefile
+#ifndef TT_MB
+#define TT_MB 64
+#endif
+
+///What a stored score says about the real score
+enum Bound
+{
+	BOUND_NONE = 0,
+	///The real score is at most the stored score (no move reached alpha)
+	BOUND_UPPER = 1,
+	///The real score is at least the stored score (a move reached beta)
+	BOUND_LOWER = 2,
+	///The stored score is the real score
+	BOUND_EXACT = 3
+};
+
+///One search result, as read from or written to the transposition table
+struct TTData
+{
+	///The best move found, myMove::data, 0 if none
+	uint16_t move;
+	///The negamax score for the side to move of the state, as AI::search returns it. Mate
+	///scores carry no distance to the mate, so an entry holds at whatever ply it is found
+	int16_t score;
+	///The depth left when the score was found, 0 for the quiescence search
+	int8_t depth;
+	///The Bound of the score in the low 2 bits, the search generation in the others
+	uint8_t genBound;
+	
+	Bound bound() const
+	{
+		return Bound(genBound & 3);
+	}
+};
+
+///A slot of the table. The threads read and write it without locking: the key is
+///stored XORed with the data, so an entry torn by two threads writing at once no
+///longer matches its key and is ignored
+struct TTEntry
+{
+	std::atomic<uint64_t> keyXorData;
+	std::atomic<uint64_t> data;
+};
+
+///The entries for one index of the table, they fill a cache line
+struct alignas(64) TTCluster
+{
+	TTEntry entry[4];
+};
+
+///A fixed size hash table of search results, indexed with the Zobrist key of the position
+class TranspositionTable
+{
+public:
+	TranspositionTable();
+	~TranspositionTable();
+	
+	///Allocates mb megabytes (rounded down to a power of two) and clears them
+	void resize(size_t mb);
+	
+	///Forgets every entry
+	void clear();
+	
+	///Starts a new search, so the entries of the previous ones are replaced first
+	void newSearch();
+	
+	///Copies the entry for key into data, returns false if the position is not in the table
+	bool probe(Key key, TTData &data) const;
+	
+	///Stores a search result for key, replacing the least useful entry of its cluster
+	void store(Key key, int score, Bound bound, int depth, uint16_t move);
+	
+private:
+	TTCluster *table;
+	size_t clusterMask;
+	uint8_t generation;
+};
+
+#endif
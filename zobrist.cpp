@@ -0,0 +1,33 @@
+#include "zobrist.h"
+
+Key ZobristPieces[2][6][64];
+Key ZobristCastling[16];
+Key ZobristEnPassant[8];
+Key ZobristSide;
+
+/*************************************************************************/
+void initZobrist()
+{
+	//a fixed seed, so the keys are the same in every game
+	uint64_t seed = 1070372;
+	
+	for(int player = 0; player < 2; player++)
+	{
+		for(int type = PAWN; type <= KING; type++)
+		{
+			for(int sq = 0; sq < 64; sq++)
+			{
+				ZobristPieces[player][type][sq] = random64(seed);
+			}
+		}
+	}
+	for(int i = 0; i < 16; i++)
+	{
+		ZobristCastling[i] = random64(seed);
+	}
+	for(int file = 0; file < 8; file++)
+	{
+		ZobristEnPassant[file] = random64(seed);
+	}
+	ZobristSide = random64(seed);
+}
@@ -0,0 +1,21 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "bitboard.h"
+
+///A 64-bit hash of a position, the XOR of the Zobrist keys of everything in it
+typedef uint64_t Key;
+
+///Key of each piece type of each player on each square
+extern Key ZobristPieces[2][6][64];
+///Key of each combination of castling rights
+extern Key ZobristCastling[16];
+///Key of the file of the en passant square
+extern Key ZobristEnPassant[8];
+///Key added when black is to move
+extern Key ZobristSide;
+
+///Fills the key tables, must be called once before any key is computed
+void initZobrist();
+
+#endif